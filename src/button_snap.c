@@ -0,0 +1,62 @@
+#include "common.h"
+#include "button_snap.h"
+
+// --------------------------------------------------
+
+struct button_snap button_snap_state;
+
+// --------------------------------------------------
+
+void button_snap_init(struct button_snap *snap) {
+
+  for(uint8_t i = 0; i < BUTTON_STATE_BYTES; i++) {
+    snap->frame[0][i] = 0;
+    snap->frame[1][i] = 0;
+  }
+  snap->current = 0;
+  snap->seq = 0;
+
+}
+
+// --------------------------------------------------
+
+void button_snap_publish(struct button_snap *snap, const uint8_t *frame) {
+
+  uint8_t idle = snap->current ^ 0x01U;
+
+  for(uint8_t i = 0; i < BUTTON_STATE_BYTES; i++) {
+    snap->frame[idle][i] = frame[i];
+  }
+
+  snap->current = idle;
+  snap->seq++;
+
+}
+
+// --------------------------------------------------
+
+uint8_t button_snap_read(struct button_snap *snap, uint8_t *frame) {
+
+  uint8_t seq_start;
+
+  do {
+    seq_start = snap->seq;
+    uint8_t current = snap->current;
+    for(uint8_t i = 0; i < BUTTON_STATE_BYTES; i++) {
+      frame[i] = snap->frame[current][i];
+    }
+  } while((uint8_t) (snap->seq - seq_start) >= 2);
+
+  // Counter as seen before the copy; if it has moved on by the next call to
+  // button_snap_seq, newer state may be available
+  return seq_start;
+
+}
+
+// --------------------------------------------------
+
+uint8_t button_snap_seq(struct button_snap *snap) {
+
+  return snap->seq;
+
+}
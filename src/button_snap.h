@@ -0,0 +1,43 @@
+// Tear-free snapshots of button state
+
+#ifndef BUTTON_SNAP_H
+#define BUTTON_SNAP_H
+
+/*
+ * Double-buffered frame of button state bytes with a sequence counter
+ * - The producer fills the idle buffer, makes it current with a single byte
+ *   store, then increments the sequence counter
+ * - A buffer is only overwritten after two publishes, so a reader retries
+ *   only if the counter moved by two or more while it was copying
+ * - A reader in an interrupt that preempted the producer always sees the
+ *   current buffer complete and never retries
+ * - One producer per snapshot; any number of readers
+ */
+
+#include "common.h"
+#include <stdint.h>
+
+// --------------------------------------------------
+
+struct button_snap {
+  volatile uint8_t frame[2][BUTTON_STATE_BYTES];
+  volatile uint8_t current;
+  volatile uint8_t seq;
+};
+
+// Acknowledged (debounced) button states, published by the scan loop
+extern struct button_snap button_snap_state;
+
+// --------------------------------------------------
+
+void button_snap_init(struct button_snap *);
+
+void button_snap_publish(struct button_snap *, const uint8_t *);
+
+uint8_t button_snap_read(struct button_snap *, uint8_t *);
+
+uint8_t button_snap_seq(struct button_snap *);
+
+// --------------------------------------------------
+
+#endif
@@ -15,6 +15,12 @@
 // PWM duty cycle maximum value
 #define PWM_MAX 255U
 
+// Number of buttons (60, round up to multiple of 8)
+#define BUTTON_COUNT 64U
+
+// Number of bytes used to hold button states
+#define BUTTON_STATE_BYTES 8U
+
 // --------------------------------------------------
 
 #endif
@@ -0,0 +1,437 @@
+#include "common.h"
+#include "debounce.h"
+#include "ee_store.h"
+
+// Adaptive mode: layout of debounce_learn entries
+#define LEARN_WINDOW_MASK 0x0fU
+#define LEARN_CLEAN_UNIT 0x10U
+#define LEARN_CLEAN_MASK 0xf0U
+
+// --------------------------------------------------
+
+// Time since a button's state was last acknowledged (ms, saturating)
+uint8_t debounce_age[BUTTON_COUNT];
+
+// Time elapsed since the previous scan (ms)
+uint8_t debounce_elapsed;
+
+// Statistics, all modes
+uint16_t debounce_acks;
+uint16_t debounce_reverts;
+uint32_t debounce_delay;
+
+// --------------------------------------------------
+
+// Advance a duration by the time elapsed since the previous scan (saturating)
+uint8_t debounce_advance(uint8_t duration) {
+
+  if(duration > 0xffU - debounce_elapsed) {
+    return 0xffU;
+  }
+  return duration + debounce_elapsed;
+
+}
+
+// --------------------------------------------------
+
+// Record an acknowledged change, detected the given time (ms) after its first
+// edge
+void debounce_ack(uint8_t button, uint8_t delay) {
+
+  if(debounce_age[button] <= DEBOUNCE_CHATTER_SPAN
+  && debounce_reverts < 0xffffU) {
+    debounce_reverts++;
+  }
+  debounce_age[button] = 0;
+
+  if(debounce_acks < 0xffffU) {
+    debounce_acks++;
+    debounce_delay += delay;
+  }
+
+}
+
+// --------------------------------------------------
+
+#if DEBOUNCE_MODE == DEBOUNCE_MODE_HOLD
+
+// Time a button's unacknowledged state has held for (ms)
+uint8_t debounce_count[BUTTON_COUNT];
+
+// --------------------------------------------------
+
+void debounce_mode_init() {
+
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    debounce_count[i] = 0;
+  }
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_mode_byte(uint8_t byte_index, uint8_t raw, uint8_t acked) {
+
+  uint8_t flip = 0;
+  uint8_t *count = &debounce_count[byte_index * 8];
+
+  for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
+    // If button's live state does not match acknowledged state
+    if((raw ^ acked) & (1 << bit_index)) {
+      // If unacknowledged state has held long enough
+      if(count[bit_index] >= DEBOUNCE_HOLD_DUR) {
+        debounce_ack(byte_index * 8 + bit_index, count[bit_index]);
+        count[bit_index] = 0;
+        flip |= (1 << bit_index);
+      } else {
+        count[bit_index] = debounce_advance(count[bit_index]);
+      }
+    }
+    // If button's live state matches acknowledged state
+    else {
+      count[bit_index] = 0;
+    }
+  }
+
+  return flip;
+
+}
+
+// --------------------------------------------------
+
+void debounce_service() {
+
+}
+
+#endif
+
+// --------------------------------------------------
+
+#if DEBOUNCE_MODE == DEBOUNCE_MODE_ADAPTIVE
+
+// Live states from the previous scan
+uint8_t debounce_raw_prev[BUTTON_STATE_BYTES];
+
+// Time since a button's live state last changed (ms, saturating)
+uint8_t debounce_stable[BUTTON_COUNT];
+
+// Time since the first edge of an unacknowledged change, plus one; 0 if none
+uint8_t debounce_episode[BUTTON_COUNT];
+
+// Buttons whose last change was acknowledged and not yet followed by an edge
+uint8_t debounce_acked_last[BUTTON_STATE_BYTES];
+
+// Hold window (low nibble) and transitions without bounce (high nibble)
+uint8_t debounce_learn[BUTTON_COUNT];
+
+// Statistics: longest first-to-last edge span, bounces that got through
+uint8_t debounce_bounce_worst[BUTTON_COUNT];
+uint8_t debounce_chatter_count[BUTTON_COUNT];
+
+// Persistence state
+uint8_t debounce_dirty;
+uint16_t debounce_idle;
+uint8_t debounce_active;
+
+// --------------------------------------------------
+
+void debounce_mode_init() {
+
+  // Learned windows, if ever stored (refer to ee_store.h)
+  uint8_t missing = ee_store_get(EE_STORE_KEY_DEBOUNCE, debounce_learn);
+
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    uint8_t window = DEBOUNCE_WINDOW_INIT;
+    if(!missing) {
+      window = debounce_learn[i] & LEARN_WINDOW_MASK;
+      if(window < DEBOUNCE_WINDOW_MIN) {
+        window = DEBOUNCE_WINDOW_MIN;
+      }
+    }
+    debounce_learn[i] = window;
+    debounce_stable[i] = 0;
+    debounce_episode[i] = 0;
+    debounce_bounce_worst[i] = 0;
+    debounce_chatter_count[i] = 0;
+  }
+  for(uint8_t i = 0; i < BUTTON_STATE_BYTES; i++) {
+    debounce_raw_prev[i] = 0;
+    debounce_acked_last[i] = 0;
+  }
+
+  debounce_dirty = 0;
+  debounce_idle = 0;
+  debounce_active = 0;
+
+}
+
+// --------------------------------------------------
+
+// Widen a button's window to at least the given time (ms)
+void debounce_widen(uint8_t button, uint8_t window) {
+
+  if(window > DEBOUNCE_WINDOW_MAX) {
+    window = DEBOUNCE_WINDOW_MAX;
+  }
+  if(window > (debounce_learn[button] & LEARN_WINDOW_MASK)) {
+    debounce_learn[button] = window;
+    debounce_dirty = 1;
+  }
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_mode_byte(uint8_t byte_index, uint8_t raw, uint8_t acked) {
+
+  uint8_t flip = 0;
+  uint8_t edges = raw ^ debounce_raw_prev[byte_index];
+  uint8_t prev = debounce_raw_prev[byte_index];
+  debounce_raw_prev[byte_index] = raw;
+
+  for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
+
+    uint8_t button = byte_index * 8 + bit_index;
+    uint8_t mask = 1 << bit_index;
+    uint8_t stable = debounce_stable[button];
+    uint8_t window = debounce_learn[button] & LEARN_WINDOW_MASK;
+
+    if(edges & mask) {
+      if(debounce_episode[button]) {
+        // A differing state reverted before acknowledgement; keep headroom
+        // above how long it held
+        if((prev ^ acked) & mask) {
+          debounce_widen(button, stable + DEBOUNCE_MARGIN);
+        }
+      } else {
+        // First edge away from a freshly acknowledged state: a bounce got
+        // through
+        if((debounce_acked_last[byte_index] & mask)
+        && stable < DEBOUNCE_CHATTER_SPAN) {
+          if(debounce_chatter_count[button] < 0xffU) {
+            debounce_chatter_count[button]++;
+          }
+          debounce_widen(button, stable + DEBOUNCE_MARGIN);
+        }
+        debounce_acked_last[byte_index] &= ~mask;
+        debounce_episode[button] = 1;
+      }
+      stable = 0;
+    } else {
+      stable = debounce_advance(stable);
+    }
+    debounce_stable[button] = stable;
+
+    if(!debounce_episode[button]) {
+      continue;
+    }
+    debounce_active = 1;
+
+    if(stable >= window) {
+      uint8_t span = debounce_episode[button] - 1 - stable;
+      // Live state differs and has held long enough
+      if((raw ^ acked) & mask) {
+        flip |= mask;
+        debounce_acked_last[byte_index] |= mask;
+        debounce_ack(button, debounce_episode[button] - 1);
+        if(span > debounce_bounce_worst[button]) {
+          debounce_bounce_worst[button] = span;
+        }
+        // Narrow the window after enough clean transitions
+        if(span) {
+          debounce_learn[button] &= LEARN_WINDOW_MASK;
+        } else {
+          debounce_learn[button] += LEARN_CLEAN_UNIT;
+          if(!(debounce_learn[button] & LEARN_CLEAN_MASK)
+          && window > DEBOUNCE_WINDOW_MIN) {
+            debounce_learn[button] = window - 1;
+            debounce_dirty = 1;
+          }
+        }
+      }
+      debounce_episode[button] = 0;
+    } else {
+      debounce_episode[button] = debounce_advance(debounce_episode[button]);
+    }
+
+  }
+
+  return flip;
+
+}
+
+// --------------------------------------------------
+
+void debounce_service() {
+
+  // Only save windows once nothing has bounced for a while
+  if(debounce_active) {
+    debounce_active = 0;
+    debounce_idle = 0;
+    return;
+  }
+  if(debounce_idle < DEBOUNCE_SAVE_IDLE) {
+    debounce_idle += debounce_elapsed;
+    return;
+  }
+  if(!debounce_dirty) {
+    return;
+  }
+
+  // Hand the windows to the store, which writes them in the background
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    ee_store_set_byte(EE_STORE_KEY_DEBOUNCE, i,
+    debounce_learn[i] & LEARN_WINDOW_MASK);
+  }
+  debounce_dirty = 0;
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_window(uint8_t button) {
+
+  return debounce_learn[button] & LEARN_WINDOW_MASK;
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_bounce_max(uint8_t button) {
+
+  return debounce_bounce_worst[button];
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_chatter(uint8_t button) {
+
+  return debounce_chatter_count[button];
+
+}
+
+#endif
+
+// --------------------------------------------------
+
+#if DEBOUNCE_MODE == DEBOUNCE_MODE_EAGER
+
+// Time a button is still locked out for (ms)
+uint8_t debounce_lockout[BUTTON_COUNT];
+
+// --------------------------------------------------
+
+void debounce_mode_init() {
+
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    debounce_lockout[i] = 0;
+  }
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_mode_byte(uint8_t byte_index, uint8_t raw, uint8_t acked) {
+
+  uint8_t flip = 0;
+  uint8_t *lockout = &debounce_lockout[byte_index * 8];
+
+  for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
+    uint8_t mask = 1 << bit_index;
+    // Ignore everything, including bounces, until lockout ends
+    if(lockout[bit_index]) {
+      lockout[bit_index] = (lockout[bit_index] > debounce_elapsed)
+      ? lockout[bit_index] - debounce_elapsed : 0;
+    }
+    // Acknowledge the first edge immediately
+    else if((raw ^ acked) & mask) {
+      flip |= mask;
+      lockout[bit_index] = (raw & mask) ? DEBOUNCE_LOCKOUT_PRESS
+      : DEBOUNCE_LOCKOUT_RELEASE;
+      debounce_ack(byte_index * 8 + bit_index, 0);
+    }
+  }
+
+  return flip;
+
+}
+
+// --------------------------------------------------
+
+void debounce_service() {
+
+}
+
+#endif
+
+// --------------------------------------------------
+
+void debounce_init() {
+
+  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    debounce_age[i] = 0xffU;
+  }
+  debounce_elapsed = 1;
+  debounce_stat_reset();
+
+  debounce_mode_init();
+
+}
+
+// --------------------------------------------------
+
+void debounce_tick(uint8_t elapsed) {
+
+  debounce_elapsed = elapsed;
+
+}
+
+// --------------------------------------------------
+
+uint8_t debounce_byte(uint8_t byte_index, uint8_t raw, uint8_t acked) {
+
+  uint8_t flip = debounce_mode_byte(byte_index, raw, acked);
+
+  uint8_t *age = &debounce_age[byte_index * 8];
+  for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
+    age[bit_index] = debounce_advance(age[bit_index]);
+  }
+
+  return flip;
+
+}
+
+// --------------------------------------------------
+
+uint16_t debounce_stat_acks() {
+
+  return debounce_acks;
+
+}
+
+// --------------------------------------------------
+
+uint16_t debounce_stat_reverts() {
+
+  return debounce_reverts;
+
+}
+
+// --------------------------------------------------
+
+uint32_t debounce_stat_delay() {
+
+  return debounce_delay;
+
+}
+
+// --------------------------------------------------
+
+void debounce_stat_reset() {
+
+  debounce_acks = 0;
+  debounce_reverts = 0;
+  debounce_delay = 0;
+
+}
@@ -0,0 +1,101 @@
+// Button debouncing
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+/*
+ * Mode selected at build time, e.g.
+ * "make compile OPTS=-DDEBOUNCE_MODE=DEBOUNCE_MODE_ADAPTIVE"
+ * - Hold: a new state is acknowledged once it has held for DEBOUNCE_HOLD_DUR
+ *   after it was first seen, identical for every button
+ * - Eager: the first edge is acknowledged immediately, then the button is
+ *   ignored for DEBOUNCE_LOCKOUT_PRESS after a press or
+ *   DEBOUNCE_LOCKOUT_RELEASE after a release
+ * - Adaptive: same rule as hold, but each button has its own hold window
+ *   learned at runtime and persisted to EEPROM (refer to ee_store.h)
+ *   - A bounce that held for nearly the whole window before reverting widens
+ *     the window to keep DEBOUNCE_MARGIN of headroom
+ *   - An acknowledged state that reverts within DEBOUNCE_CHATTER_SPAN
+ *     was a bounce that got through; it is counted and widens the window
+ *   - Every 16 transitions without any bounce narrow the window by 1 ms,
+ *     down to DEBOUNCE_WINDOW_MIN
+ * All durations are in milliseconds of wall-clock time, so they hold while
+ * the scan rate changes (refer to scan_rate.h): before each scan,
+ * debounce_tick gives the milliseconds elapsed since the previous one, and
+ * every counter advances by that much instead of by one scan.
+ *
+ * Statistics kept in every mode, for comparing modes on the same hardware:
+ * - Acknowledged changes
+ * - Reverts: changes acknowledged within DEBOUNCE_CHATTER_SPAN of the
+ *   previous one, i.e. likely false triggers
+ * - Total delay from first edge to acknowledgement (ms); divide by the
+ *   number of acknowledged changes for the mean
+ */
+
+#include "common.h"
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Debounce modes
+#define DEBOUNCE_MODE_HOLD 0
+#define DEBOUNCE_MODE_ADAPTIVE 1
+#define DEBOUNCE_MODE_EAGER 2
+
+#ifndef DEBOUNCE_MODE
+#define DEBOUNCE_MODE DEBOUNCE_MODE_HOLD
+#endif
+
+// Hold mode: duration that new button state must hold to be acknowledged (ms)
+#define DEBOUNCE_HOLD_DUR 5U
+
+// Eager mode: time to ignore a button for after a press or a release (ms)
+#define DEBOUNCE_LOCKOUT_PRESS 6U
+#define DEBOUNCE_LOCKOUT_RELEASE 10U
+
+// Adaptive mode: window limits, starting window and learning parameters (ms)
+#define DEBOUNCE_WINDOW_MIN 1U
+#define DEBOUNCE_WINDOW_MAX 15U
+#define DEBOUNCE_WINDOW_INIT DEBOUNCE_HOLD_DUR
+#define DEBOUNCE_MARGIN 2U
+
+// Changes acknowledged this soon after the previous one count as reverts (ms)
+#define DEBOUNCE_CHATTER_SPAN 10U
+
+// Adaptive mode: time without any bouncing button before windows are saved
+// (ms)
+#define DEBOUNCE_SAVE_IDLE 1000U
+
+// --------------------------------------------------
+
+void debounce_init();
+
+void debounce_tick(uint8_t);
+
+uint8_t debounce_byte(uint8_t, uint8_t, uint8_t);
+
+void debounce_service();
+
+uint16_t debounce_stat_acks();
+
+uint16_t debounce_stat_reverts();
+
+uint32_t debounce_stat_delay();
+
+void debounce_stat_reset();
+
+#if DEBOUNCE_MODE == DEBOUNCE_MODE_ADAPTIVE
+
+uint8_t debounce_window(uint8_t);
+
+uint8_t debounce_bounce_max(uint8_t);
+
+uint8_t debounce_chatter(uint8_t);
+
+#endif
+
+// --------------------------------------------------
+
+#endif
@@ -0,0 +1,255 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "ee_store.h"
+#include "timer.h"
+
+// Record bytes besides the payload: key, version, sequence, CRC16
+#define RECORD_EXTRA 5U
+
+// Payload bytes of all keys
+#define CACHE_BYTES (EE_STORE_SIZE_BANK + EE_STORE_SIZE_USAGE \
++ EE_STORE_SIZE_DEBOUNCE)
+
+// Largest record
+#define RECORD_MAX (EE_STORE_SIZE_DEBOUNCE + RECORD_EXTRA)
+
+// EEPROM used by all slots of all keys
+#define AREA_BYTES ((CACHE_BYTES + (EE_STORE_KEY_COUNT * RECORD_EXTRA)) \
+* EE_STORE_SLOTS)
+
+// --------------------------------------------------
+
+// Payload size per key
+const uint8_t ee_store_size[EE_STORE_KEY_COUNT] = {
+  EE_STORE_SIZE_BANK, EE_STORE_SIZE_USAGE, EE_STORE_SIZE_DEBOUNCE
+};
+
+// Slots of all keys, one key after the other
+uint8_t EEMEM ee_store_area[AREA_BYTES];
+
+// Per key: offset into cache and EEPROM area, newest slot and its sequence
+uint8_t ee_store_cache_offset[EE_STORE_KEY_COUNT];
+uint16_t ee_store_area_offset[EE_STORE_KEY_COUNT];
+uint8_t ee_store_slot[EE_STORE_KEY_COUNT];
+uint8_t ee_store_seq[EE_STORE_KEY_COUNT];
+
+// Per key: loaded or written since boot, waiting to be written, last change
+uint8_t ee_store_valid;
+uint8_t ee_store_dirty;
+uint32_t ee_store_changed[EE_STORE_KEY_COUNT];
+
+// Current values
+uint8_t ee_store_cache[CACHE_BYTES];
+
+// Record being written by the interrupt
+volatile uint8_t ee_store_record[RECORD_MAX];
+volatile uint16_t ee_store_write_addr;
+volatile uint8_t ee_store_write_len;
+volatile uint8_t ee_store_write_pos;
+volatile uint8_t ee_store_busy;
+
+// --------------------------------------------------
+
+// Fill the record buffer for a key's current value; return record length
+uint8_t ee_store_build(uint8_t key, uint8_t seq) {
+
+  uint8_t size = ee_store_size[key];
+  uint8_t *payload = &ee_store_cache[ee_store_cache_offset[key]];
+  uint16_t crc = 0xffffU;
+
+  for(uint8_t i = 0; i < size; i++) {
+    ee_store_record[i] = payload[i];
+  }
+  ee_store_record[size] = key;
+  ee_store_record[size + 1] = EE_STORE_VERSION;
+  ee_store_record[size + 2] = seq;
+  for(uint8_t i = 0; i < size + 3U; i++) {
+    crc = _crc16_update(crc, ee_store_record[i]);
+  }
+  ee_store_record[size + 3] = (uint8_t) crc;
+  ee_store_record[size + 4] = (uint8_t) (crc >> 8);
+
+  return size + RECORD_EXTRA;
+
+}
+
+// --------------------------------------------------
+
+// Check a slot; return 0 and its sequence number if it holds a valid record
+uint8_t ee_store_check(uint8_t key, uint8_t slot, uint8_t *seq) {
+
+  uint8_t size = ee_store_size[key];
+  uint8_t len = size + RECORD_EXTRA;
+  uint8_t *addr = &ee_store_area[ee_store_area_offset[key] + (slot * len)];
+  uint16_t crc = 0xffffU;
+
+  for(uint8_t i = 0; i < size + 3U; i++) {
+    crc = _crc16_update(crc, eeprom_read_byte(&addr[i]));
+  }
+  if(eeprom_read_byte(&addr[size]) != key
+  || eeprom_read_byte(&addr[size + 1]) != EE_STORE_VERSION
+  || eeprom_read_byte(&addr[size + 3]) != (uint8_t) crc
+  || eeprom_read_byte(&addr[size + 4]) != (uint8_t) (crc >> 8)) {
+    return 1;
+  }
+  *seq = eeprom_read_byte(&addr[size + 2]);
+
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+void ee_store_init() {
+
+  uint8_t cache_offset = 0;
+  uint16_t area_offset = 0;
+
+  ee_store_valid = 0;
+  ee_store_dirty = 0;
+  ee_store_busy = 0;
+
+  for(uint8_t key = 0; key < EE_STORE_KEY_COUNT; key++) {
+
+    uint8_t size = ee_store_size[key];
+    ee_store_cache_offset[key] = cache_offset;
+    ee_store_area_offset[key] = area_offset;
+    cache_offset += size;
+    area_offset += (size + RECORD_EXTRA) * EE_STORE_SLOTS;
+
+    // Newest valid record; sequence numbers wrap
+    ee_store_slot[key] = EE_STORE_SLOTS - 1;
+    ee_store_seq[key] = 0;
+    for(uint8_t slot = 0; slot < EE_STORE_SLOTS; slot++) {
+      uint8_t seq;
+      if(ee_store_check(key, slot, &seq)) {
+        continue;
+      }
+      if(!(ee_store_valid & (1 << key))
+      || (int8_t) (seq - ee_store_seq[key]) > 0) {
+        ee_store_valid |= (1 << key);
+        ee_store_slot[key] = slot;
+        ee_store_seq[key] = seq;
+      }
+    }
+
+    uint8_t *payload = &ee_store_cache[ee_store_cache_offset[key]];
+    uint8_t *addr = &ee_store_area[ee_store_area_offset[key]
+    + (ee_store_slot[key] * (size + RECORD_EXTRA))];
+    for(uint8_t i = 0; i < size; i++) {
+      payload[i] = (ee_store_valid & (1 << key)) ? eeprom_read_byte(&addr[i])
+      : 0;
+    }
+
+  }
+
+}
+
+// --------------------------------------------------
+
+// Copy a key's value; return 1 if it was never stored (value reads as 0)
+uint8_t ee_store_get(uint8_t key, void *data) {
+
+  uint8_t *payload = &ee_store_cache[ee_store_cache_offset[key]];
+  uint8_t *out = data;
+
+  for(uint8_t i = 0; i < ee_store_size[key]; i++) {
+    out[i] = payload[i];
+  }
+
+  return (ee_store_valid & (1 << key)) ? 0 : 1;
+
+}
+
+// --------------------------------------------------
+
+void ee_store_set(uint8_t key, const void *data) {
+
+  const uint8_t *in = data;
+
+  for(uint8_t i = 0; i < ee_store_size[key]; i++) {
+    ee_store_set_byte(key, i, in[i]);
+  }
+
+}
+
+// --------------------------------------------------
+
+void ee_store_set_byte(uint8_t key, uint8_t index, uint8_t value) {
+
+  uint8_t *payload = &ee_store_cache[ee_store_cache_offset[key]];
+
+  if(payload[index] == value && (ee_store_valid & (1 << key))) {
+    return;
+  }
+  payload[index] = value;
+  ee_store_valid |= (1 << key);
+  ee_store_dirty |= (1 << key);
+  ee_store_changed[key] = timer_read_long();
+
+}
+
+// --------------------------------------------------
+
+void ee_store_service() {
+
+  if(ee_store_busy || !ee_store_dirty) {
+    return;
+  }
+
+  uint32_t now = timer_read_long();
+  for(uint8_t key = 0; key < EE_STORE_KEY_COUNT; key++) {
+    if(!(ee_store_dirty & (1 << key))
+    || now - ee_store_changed[key] < EE_STORE_SETTLE) {
+      continue;
+    }
+
+    // Next slot, next sequence number
+    uint8_t slot = ee_store_slot[key] + 1;
+    if(slot >= EE_STORE_SLOTS) {
+      slot = 0;
+    }
+    uint8_t seq = ee_store_seq[key] + 1;
+    uint8_t len = ee_store_build(key, seq);
+    ee_store_slot[key] = slot;
+    ee_store_seq[key] = seq;
+    ee_store_dirty &= ~(1 << key);
+
+    // Hand over to the interrupt
+    ee_store_write_addr = (uint16_t) (uintptr_t)
+    &ee_store_area[ee_store_area_offset[key] + (slot * len)];
+    ee_store_write_len = len;
+    ee_store_write_pos = 0;
+    ee_store_busy = 1;
+    EECR |= (1 << EERIE);
+    return;
+  }
+
+}
+
+// --------------------------------------------------
+
+ISR(EE_READY_vect) {
+
+  // Skip bytes that already hold the right value
+  while(ee_store_write_pos < ee_store_write_len) {
+    uint8_t data = ee_store_record[ee_store_write_pos];
+    EEAR = ee_store_write_addr + ee_store_write_pos;
+    ee_store_write_pos++;
+    EECR |= (1 << EERE);
+    if(EEDR != data) {
+      // Erase and write; the ready interrupt fires again when done
+      EEDR = data;
+      EECR = (1 << EERIE) | (1 << EEMPE);
+      EECR |= (1 << EEPE);
+      return;
+    }
+  }
+
+  EECR &= ~(1 << EERIE);
+  ee_store_busy = 0;
+
+}
@@ -0,0 +1,65 @@
+// Non-blocking EEPROM key/value store
+
+#ifndef EE_STORE_H
+#define EE_STORE_H
+
+/*
+ * Settings kept in a RAM cache and written to EEPROM in the background
+ * - Every key has a fixed size and EE_STORE_SLOTS record slots in EEPROM;
+ *   each write of a key goes to its next slot, spreading wear across them
+ * - Record: payload, key, format version, sequence number, then a CRC16 over
+ *   all of these; bytes are written in that order, so the CRC lands last and
+ *   a record cut short by power loss fails its check, leaving the previous
+ *   slot in use
+ * - At boot, the valid record with the newest sequence number of each key is
+ *   loaded into the cache; reads are served from the cache only
+ * - A write updates the cache and marks the key dirty; ee_store_service
+ *   queues the record once the key has been left alone for EE_STORE_SETTLE
+ *   timer ticks, so a value changing constantly costs one record per pause
+ * - The EEPROM ready interrupt writes the record one byte at a time (about
+ *   3.3 ms each), skipping bytes already holding the right value; nothing
+ *   waits on EEPROM, and one record is in flight at a time
+ * Records with another EE_STORE_VERSION read as missing.
+ */
+
+#include "common.h"
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Keys and payload sizes (bytes)
+#define EE_STORE_KEY_BANK 0U
+#define EE_STORE_KEY_USAGE 1U
+#define EE_STORE_KEY_DEBOUNCE 2U
+#define EE_STORE_KEY_COUNT 3U
+
+#define EE_STORE_SIZE_BANK 1U
+#define EE_STORE_SIZE_USAGE 4U
+#define EE_STORE_SIZE_DEBOUNCE BUTTON_COUNT
+
+// Record format; change when a key's size or meaning changes
+#define EE_STORE_VERSION 2U
+
+// Record slots per key
+#define EE_STORE_SLOTS 8U
+
+// Time a key must go unchanged before it is written (timer ticks, 2 s)
+#define EE_STORE_SETTLE 500000UL
+
+// --------------------------------------------------
+
+void ee_store_init();
+
+uint8_t ee_store_get(uint8_t, void *);
+
+void ee_store_set(uint8_t, const void *);
+
+void ee_store_set_byte(uint8_t, uint8_t, uint8_t);
+
+void ee_store_service();
+
+// --------------------------------------------------
+
+#endif
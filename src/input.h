@@ -0,0 +1,105 @@
+// Button input source
+
+#ifndef INPUT_H
+#define INPUT_H
+
+/*
+ * Backend selected at build time, e.g.
+ * "make compile OPTS=-DINPUT_BACKEND=INPUT_BACKEND_MCP23S17"
+ * - MCP23017: I/O expanders on TWI at 100 kHz (refer to io_expand.h)
+ * - MCP23S17: I/O expanders on SPI at 8 MHz sharing one chip select, told
+ *   apart by hardware address (refer to io_expand_spi.h)
+ * - Matrix: 10x6 diode matrix on the 328P's own pins, no expanders
+ * Every backend fills the same frame, a set bit meaning pressed. Expanders
+ * missing at boot read as released and are retried; an MCP23017 that stops
+ * responding keeps its last state and is probed again on every scan.
+ * - Expanders: expander n's port A and port B in bytes 2n and 2n + 1
+ * - Matrix: button index row * 6 + column, 8 per byte
+ *
+ * Matrix wiring and timing:
+ * - Rows 0 ~ 5: pins 2 ~ 7 (PD2 ~ PD7); rows 6 ~ 9: pins 8 ~ 11 (PB0 ~ PB3)
+ * - Columns 0 ~ 5: pins A0 ~ A5 (PC0 ~ PC5), internal pull-ups
+ * - Diodes with cathodes towards the rows; the strobed row is driven low,
+ *   the others float
+ * - Timer2 interrupt every INPUT_MATRIX_SETTLE_US latches the columns of the
+ *   strobed row and moves to the next one, so a full scan takes ten settle
+ *   times (1 ms by default); the interrupt only swaps double-buffered rows at
+ *   the end of a scan, the frame is built when read
+ * - Two rows sharing two or more pressed columns may contain a ghost key;
+ *   such rectangles are counted (input_matrix_ghosts) but passed through, so
+ *   real chords are never masked
+ * - Uses the text LCD's pins and Timer2 (refer to text_lcd.h)
+ *
+ * Inputs are read in INPUT_GROUP_COUNT groups of INPUT_GROUP_BYTES frame
+ * bytes (one expander each), so a scan can be pipelined: input_read_start
+ * begins reading a group and returns, input_read_finish waits for it and
+ * stores it in the frame. Only one group may be in flight.
+ * - MCP23017: the transfer runs from the TWI interrupt; while waiting, queued
+ *   MIDI output is serviced
+ * - MCP23S17: at 8 MHz a transfer takes a few microseconds and is done by
+ *   input_read_finish
+ * - Matrix: starting group 0 builds a frame from the latest complete scan
+ * input_read_all reads every group in turn.
+ *
+ * input_changed reports whether any input may have changed since the last
+ * read; for the matrix, whether a new frame is complete. Building with
+ * INPUT_INT enables the expanders' interrupt on change,
+ * with both interrupt outputs mirrored and open drain, wired together to
+ * pin 2 (PD2); without it, a change is always reported.
+ */
+
+#include "common.h"
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Backends
+#define INPUT_BACKEND_MCP23017 0
+#define INPUT_BACKEND_MCP23S17 1
+#define INPUT_BACKEND_MATRIX 2
+
+#ifndef INPUT_BACKEND
+#define INPUT_BACKEND INPUT_BACKEND_MCP23017
+#endif
+
+// Number of I/O expanders
+#define INPUT_EXPANDER_COUNT 4U
+
+// Groups read per scan, frame bytes per group
+#define INPUT_GROUP_COUNT INPUT_EXPANDER_COUNT
+#define INPUT_GROUP_BYTES 2U
+
+// Time allowed for I/O expanders to respond at boot (timer ticks, 100 ms)
+#define INPUT_PROBE_TIMEOUT 25000UL
+
+// Delay between probes of I/O expanders not yet responding (microseconds)
+#define INPUT_PROBE_RETRY 200U
+
+// Matrix: time between strobing a row and reading it (microseconds, <= 128)
+#ifndef INPUT_MATRIX_SETTLE_US
+#define INPUT_MATRIX_SETTLE_US 100U
+#endif
+
+// --------------------------------------------------
+
+uint8_t input_init();
+
+void input_read_start(uint8_t);
+
+void input_read_finish(uint8_t, uint8_t *);
+
+void input_read_all(uint8_t *);
+
+uint8_t input_changed();
+
+#if INPUT_BACKEND == INPUT_BACKEND_MATRIX
+
+uint16_t input_matrix_ghosts();
+
+#endif
+
+// --------------------------------------------------
+
+#endif
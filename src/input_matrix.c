@@ -0,0 +1,215 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "input.h"
+
+#if INPUT_BACKEND == INPUT_BACKEND_MATRIX
+
+#define MATRIX_ROWS 10U
+#define MATRIX_COLS 6U
+
+// Columns on PC0 ~ PC5
+#define MATRIX_COL_MASK 0x3fU
+
+// Rows 0 ~ 5 on PD2 ~ PD7, rows 6 ~ 9 on PB0 ~ PB3
+#define MATRIX_ROW_MASK_D 0xfcU
+#define MATRIX_ROW_MASK_B 0x0fU
+
+// Timer2 compare value for one row per settle time (clock / 8: 0.5 us)
+#define MATRIX_OCR ((INPUT_MATRIX_SETTLE_US * 2U) - 1U)
+
+// --------------------------------------------------
+
+// Row being strobed
+volatile uint8_t input_matrix_row;
+
+// Column reads per row (set bit: pressed), double-buffered: the timer
+// interrupt fills one buffer while the other holds the latest complete scan,
+// then swaps them and increments the sequence counter
+volatile uint8_t input_matrix_rows[2][MATRIX_ROWS];
+volatile uint8_t input_matrix_current;
+volatile uint8_t input_matrix_scan_seq;
+
+// Sequence counter of the scan last read
+uint8_t input_matrix_seq;
+
+// Frame being handed out in groups
+uint8_t input_matrix_frame[BUTTON_STATE_BYTES];
+
+// Whether the last scan read had a rectangle, rectangles formed since boot
+uint8_t input_matrix_ghost_prev;
+uint16_t input_matrix_ghost_count;
+
+// --------------------------------------------------
+
+// Drive one row low, leave the others floating
+void input_matrix_select(uint8_t row) {
+
+  DDRD &= ~MATRIX_ROW_MASK_D;
+  DDRB &= ~MATRIX_ROW_MASK_B;
+  if(row < 6) {
+    DDRD |= (1 << (row + 2));
+  } else {
+    DDRB |= (1 << (row - 6));
+  }
+
+}
+
+// --------------------------------------------------
+
+// Copy the latest complete scan, flag rectangles, then pack the rows in
+// button index order (row * 6 + column)
+void input_matrix_build(uint8_t *frame) {
+
+  uint8_t rows[MATRIX_ROWS];
+
+  // The idle buffer is refilled right after a swap: retry if one happened
+  // during the copy
+  do {
+    input_matrix_seq = input_matrix_scan_seq;
+    uint8_t current = input_matrix_current;
+    for(uint8_t row = 0; row < MATRIX_ROWS; row++) {
+      rows[row] = input_matrix_rows[current][row];
+    }
+  } while(input_matrix_scan_seq != input_matrix_seq);
+
+  // Two rows sharing two or more pressed columns form a rectangle, of which
+  // one corner may be a ghost (e.g. a failed diode); counted, not filtered,
+  // so real chords always get through
+  uint8_t ghost = 0;
+  for(uint8_t i = 0; i < MATRIX_ROWS && !ghost; i++) {
+    if(!(rows[i] & (rows[i] - 1))) {
+      continue;
+    }
+    for(uint8_t j = i + 1; j < MATRIX_ROWS; j++) {
+      uint8_t shared = rows[i] & rows[j];
+      if(shared & (shared - 1)) {
+        ghost = 1;
+        break;
+      }
+    }
+  }
+  if(ghost && !input_matrix_ghost_prev && input_matrix_ghost_count < 0xffffU) {
+    input_matrix_ghost_count++;
+  }
+  input_matrix_ghost_prev = ghost;
+
+  for(uint8_t i = 0; i < BUTTON_STATE_BYTES; i++) {
+    frame[i] = 0;
+  }
+  for(uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    uint8_t first = row * MATRIX_COLS;
+    uint16_t bits = (uint16_t) rows[row] << (first % 8);
+    frame[first / 8] |= (uint8_t) bits;
+    if((first / 8U) + 1U < BUTTON_STATE_BYTES) {
+      frame[(first / 8) + 1] |= (uint8_t) (bits >> 8);
+    }
+  }
+
+}
+
+// --------------------------------------------------
+
+ISR(TIMER2_COMPA_vect) {
+
+  // Columns of the row selected one settle time ago
+  uint8_t row = input_matrix_row;
+  uint8_t fill = input_matrix_current ^ 0x01U;
+  input_matrix_rows[fill][row] = ~PINC & MATRIX_COL_MASK;
+
+  row++;
+  if(row >= MATRIX_ROWS) {
+    row = 0;
+    input_matrix_current = fill;
+    input_matrix_scan_seq++;
+  }
+  input_matrix_select(row);
+  input_matrix_row = row;
+
+}
+
+// --------------------------------------------------
+
+uint8_t input_init() {
+
+  for(uint8_t row = 0; row < MATRIX_ROWS; row++) {
+    input_matrix_rows[0][row] = 0;
+    input_matrix_rows[1][row] = 0;
+  }
+  input_matrix_current = 0;
+  input_matrix_scan_seq = 0;
+  input_matrix_seq = 0;
+  input_matrix_ghost_prev = 0;
+  input_matrix_ghost_count = 0;
+
+  // Columns: inputs with pull-ups
+  DDRC &= ~MATRIX_COL_MASK;
+  PORTC |= MATRIX_COL_MASK;
+
+  // Rows: low when driven, floating otherwise
+  PORTD &= ~MATRIX_ROW_MASK_D;
+  PORTB &= ~MATRIX_ROW_MASK_B;
+  input_matrix_row = 0;
+  input_matrix_select(0);
+
+  // Timer2: CTC, clock / 8, one row per compare match
+  TCCR2A = (1 << WGM21);
+  TCCR2B = (1 << CS21);
+  OCR2A = MATRIX_OCR;
+  TCNT2 = 0;
+  TIFR2 = (1 << OCF2A);
+  TIMSK2 |= (1 << OCIE2A);
+
+  // Wait for the first complete scan (global interrupts must be enabled)
+  while(input_matrix_scan_seq == input_matrix_seq);
+
+  return 0x01;
+
+}
+
+// --------------------------------------------------
+
+void input_read_start(uint8_t group) {
+
+  if(!group) {
+    input_matrix_build(input_matrix_frame);
+  }
+
+}
+
+// --------------------------------------------------
+
+void input_read_finish(uint8_t group, uint8_t *frame) {
+
+  for(uint8_t i = group * INPUT_GROUP_BYTES;
+  i < (group + 1) * INPUT_GROUP_BYTES; i++) {
+    frame[i] = input_matrix_frame[i];
+  }
+
+}
+
+// --------------------------------------------------
+
+void input_read_all(uint8_t *frame) {
+
+  input_matrix_build(frame);
+
+}
+
+// --------------------------------------------------
+
+uint8_t input_changed() {
+
+  return input_matrix_scan_seq != input_matrix_seq;
+
+}
+
+// --------------------------------------------------
+
+uint16_t input_matrix_ghosts() {
+
+  return input_matrix_ghost_count;
+
+}
+
+#endif
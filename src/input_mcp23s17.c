@@ -0,0 +1,100 @@
+#include "common.h"
+#include <avr/io.h>
+#include <util/delay.h>
+#include "input.h"
+
+#if INPUT_BACKEND == INPUT_BACKEND_MCP23S17
+
+#include "io_expand_spi.h"
+#include "spi.h"
+#include "timer.h"
+
+// --------------------------------------------------
+
+// I/O expanders initialized (bit per expander)
+uint8_t input_expander_ready;
+
+// --------------------------------------------------
+
+uint8_t input_init() {
+
+  spi_init();
+
+#ifdef INPUT_INT
+  // Shared interrupt line, open drain: input with pull-up
+  DDRD &= ~(1 << DDD2);
+  PORTD |= (1 << PORTD2);
+#endif
+
+  // Initialize each MCP23S17 as soon as it reads back its configuration
+  uint8_t expander_all = (1 << INPUT_EXPANDER_COUNT) - 1;
+  input_expander_ready = 0;
+  while(input_expander_ready != expander_all
+  && timer_read_long() < INPUT_PROBE_TIMEOUT) {
+    for(uint8_t expander_index = 0; expander_index < INPUT_EXPANDER_COUNT;
+    expander_index++) {
+      if(!(input_expander_ready & (1 << expander_index))
+      && !io_expand_spi_init(expander_index)) {
+        input_expander_ready |= (1 << expander_index);
+      }
+    }
+    if(input_expander_ready != expander_all) {
+      _delay_us(INPUT_PROBE_RETRY);
+    }
+  }
+
+  return input_expander_ready;
+
+}
+
+// --------------------------------------------------
+
+void input_read_start(uint8_t group) {
+
+}
+
+// --------------------------------------------------
+
+void input_read_finish(uint8_t group, uint8_t *frame) {
+
+  // Expander missing at boot: keep trying, its buttons read released
+  if(!(input_expander_ready & (1 << group))) {
+    if(!io_expand_spi_init(group)) {
+      input_expander_ready |= (1 << group);
+    }
+    frame[group * 2] = 0;
+    frame[(group * 2) + 1] = 0;
+    return;
+  }
+
+  uint16_t expander_data = io_expand_spi_read_bytes(group);
+  frame[group * 2] = (uint8_t) (expander_data >> 8);
+  frame[(group * 2) + 1] = (uint8_t) expander_data;
+
+}
+
+// --------------------------------------------------
+
+void input_read_all(uint8_t *frame) {
+
+  for(uint8_t group = 0; group < INPUT_GROUP_COUNT; group++) {
+    input_read_finish(group, frame);
+  }
+
+}
+
+// --------------------------------------------------
+
+uint8_t input_changed() {
+
+#ifdef INPUT_INT
+  // Line is low while any expander holds an unread change
+  return !(PIND & (1 << PIND2))
+  || input_expander_ready != (1 << INPUT_EXPANDER_COUNT) - 1;
+#else
+  return 1;
+#endif
+
+}
+
+#endif
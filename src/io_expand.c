@@ -3,6 +3,37 @@
 #include "io_expand.h"
 #include "twi.h"
 
+// IOCON: interrupt outputs mirrored and open drain if used
+#ifdef INPUT_INT
+#define IOCON_VALUE 0x44U
+#else
+#define IOCON_VALUE 0x00U
+#endif
+
+// --------------------------------------------------
+
+// GPIOA and GPIOB, filled by the TWI interrupt
+volatile uint8_t io_expand_read_buf[2];
+
+// --------------------------------------------------
+
+uint8_t io_expand_probe(uint8_t addr) {
+
+  addr &= 0x07;
+  addr |= 0x20;
+
+  // Transmit start condition
+  twi_transmit_start();
+  // Transmit slave address + write, note whether it was acknowledged
+  uint8_t nack = twi_transmit_slaveaddr(addr, 0);
+  // Transmit stop condition
+  twi_transmit_stop();
+
+  // Return 0 if present
+  return nack;
+
+}
+
 // --------------------------------------------------
 
 void io_expand_init(uint8_t addr) {
@@ -17,7 +48,7 @@ void io_expand_init(uint8_t addr) {
   // Transmit register address of IOCON
   twi_transmit_data(0x0a);
   // Transmit IOCON value
-  twi_transmit_data(0x00);
+  twi_transmit_data(IOCON_VALUE);
 
   // Transmit restart condition
   twi_transmit_restart();
@@ -52,6 +83,19 @@ void io_expand_init(uint8_t addr) {
   // Transmit IPOLB value
   twi_transmit_data(0x00);
 
+#ifdef INPUT_INT
+  // Transmit restart condition
+  twi_transmit_restart();
+  // Transmit slave address + write
+  twi_transmit_slaveaddr(addr, 0);
+  // Transmit register address of GPINTENA
+  twi_transmit_data(0x04);
+  // Transmit GPINTENA value
+  twi_transmit_data(0xff);
+  // Transmit GPINTENB value
+  twi_transmit_data(0xff);
+#endif
+
   // Transmit stop condition
   twi_transmit_stop();
 
@@ -97,3 +141,37 @@ uint16_t io_expand_read_bytes(uint8_t addr) {
   return ~data;
 
 }
+
+// --------------------------------------------------
+
+void io_expand_read_start(uint8_t addr) {
+
+  addr &= 0x07;
+  addr |= 0x20;
+
+  // Read GPIOA, then GPIOB
+  twi_read_start(addr, 0x12, io_expand_read_buf, 2);
+
+}
+
+// --------------------------------------------------
+
+uint8_t io_expand_read_done() {
+
+  return twi_read_done();
+
+}
+
+// --------------------------------------------------
+
+uint8_t io_expand_read_result(uint16_t *data) {
+
+  if(twi_read_error()) {
+    return 1;
+  }
+
+  *data = ~(((uint16_t) io_expand_read_buf[0] << 8) | io_expand_read_buf[1]);
+
+  return 0;
+
+}
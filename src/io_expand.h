@@ -5,14 +5,30 @@
 
 /*
  * MCP23017
+ *
+ * io_expand_read_start begins the same read as io_expand_read_bytes from the
+ * TWI interrupt and returns at once; io_expand_read_done reports when it has
+ * completed and io_expand_read_result stores its data, returning 1 without
+ * storing anything if the expander did not respond. Only one read may be in
+ * flight.
  */
 
+#include <stdint.h>
+
 // --------------------------------------------------
 
+uint8_t io_expand_probe(uint8_t);
+
 void io_expand_init(uint8_t);
 
 uint16_t io_expand_read_bytes(uint8_t);
 
+void io_expand_read_start(uint8_t);
+
+uint8_t io_expand_read_done();
+
+uint8_t io_expand_read_result(uint16_t *);
+
 // --------------------------------------------------
 
 #endif
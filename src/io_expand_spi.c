@@ -0,0 +1,81 @@
+#include "common.h"
+#include <avr/io.h>
+#include "io_expand_spi.h"
+#include "spi.h"
+
+#define OPCODE_WRITE 0x40U
+#define OPCODE_READ 0x41U
+
+// IOCON: hardware address enable, plus mirrored open drain interrupts
+#ifdef INPUT_INT
+#define IOCON_VALUE 0x4cU
+#else
+#define IOCON_VALUE 0x08U
+#endif
+
+// --------------------------------------------------
+
+// Write consecutive registers, starting at the given address
+void io_expand_spi_write(uint8_t addr, uint8_t reg, uint8_t value_a,
+uint8_t value_b, uint8_t count) {
+
+  // Chip select: active low
+  PORTB &= ~(1 << PORTB2);
+  spi_transfer(OPCODE_WRITE | ((addr & 0x07) << 1));
+  spi_transfer(reg);
+  spi_transfer(value_a);
+  if(count > 1) {
+    spi_transfer(value_b);
+  }
+  PORTB |= (1 << PORTB2);
+
+}
+
+// --------------------------------------------------
+
+uint8_t io_expand_spi_init(uint8_t addr) {
+
+  // IOCON
+  io_expand_spi_write(addr, 0x0a, IOCON_VALUE, 0, 1);
+  // IODIRA, IODIRB
+  io_expand_spi_write(addr, 0x00, 0xff, 0xff, 2);
+  // GPPUA, GPPUB
+  io_expand_spi_write(addr, 0x0c, 0xff, 0xff, 2);
+  // IPOLA, IPOLB
+  io_expand_spi_write(addr, 0x02, 0x00, 0x00, 2);
+#ifdef INPUT_INT
+  // GPINTENA, GPINTENB
+  io_expand_spi_write(addr, 0x04, 0xff, 0xff, 2);
+#endif
+
+  // No acknowledgement on SPI: read IOCON back to confirm presence
+  PORTB &= ~(1 << PORTB2);
+  spi_transfer(OPCODE_READ | ((addr & 0x07) << 1));
+  spi_transfer(0x0a);
+  uint8_t iocon = spi_transfer(0x00);
+  PORTB |= (1 << PORTB2);
+
+  // Return 0 if present
+  return iocon != IOCON_VALUE;
+
+}
+
+// --------------------------------------------------
+
+uint16_t io_expand_spi_read_bytes(uint8_t addr) {
+
+  uint16_t data = 0;
+
+  PORTB &= ~(1 << PORTB2);
+  spi_transfer(OPCODE_READ | ((addr & 0x07) << 1));
+  // Register address of GPIOA; GPIOB follows
+  spi_transfer(0x12);
+  data |= (uint16_t) spi_transfer(0x00);
+  data = data << 8;
+  data |= (uint16_t) spi_transfer(0x00);
+  PORTB |= (1 << PORTB2);
+
+  // Return data
+  return ~data;
+
+}
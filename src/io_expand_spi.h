@@ -0,0 +1,23 @@
+// Interface to SPI I/O expander
+
+#ifndef IO_EXPAND_SPI_H
+#define IO_EXPAND_SPI_H
+
+/*
+ * MCP23S17
+ * - All expanders share the SPI bus and one chip select, pin 10 (PB2)
+ * - Told apart by hardware address (A2..A0 strapped per expander); the first
+ *   IOCON write reaches every expander and enables addressing on all of them
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+uint8_t io_expand_spi_init(uint8_t);
+
+uint16_t io_expand_spi_read_bytes(uint8_t);
+
+// --------------------------------------------------
+
+#endif
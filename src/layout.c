@@ -0,0 +1,127 @@
+#include "common.h"
+#include "ee_store.h"
+#include "layout.h"
+#include "midi_sched.h"
+#include "midi_timed.h"
+
+// --------------------------------------------------
+
+// Mapping tables, active index, bank held by each table
+uint8_t layout_table[2][BUTTON_COUNT];
+volatile uint8_t layout_active;
+uint8_t layout_table_bank[2];
+
+// Note sent for each held pad
+uint8_t layout_held_note[BUTTON_COUNT];
+
+// --------------------------------------------------
+
+void layout_init() {
+
+  for(uint8_t pad = 0; pad < BUTTON_COUNT; pad++) {
+    layout_held_note[pad] = LAYOUT_NOTE_NONE;
+  }
+
+  // Bank in use before power off, bank 0 if none was saved
+  uint8_t bank;
+  ee_store_get(EE_STORE_KEY_BANK, &bank);
+  if(bank >= LAYOUT_BANK_COUNT) {
+    bank = 0;
+  }
+
+  layout_active = 0;
+  layout_stage(bank);
+  layout_swap();
+
+}
+
+// --------------------------------------------------
+
+// Fill the idle table with a bank's mapping
+void layout_stage(uint8_t bank) {
+
+  uint8_t idle = layout_active ^ 1;
+
+  for(uint8_t pad = 0; pad < BUTTON_COUNT; pad++) {
+    layout_table[idle][pad] = LAYOUT_NOTE(bank, pad) & 0x7fU;
+  }
+  layout_table_bank[idle] = bank;
+
+}
+
+// --------------------------------------------------
+
+void layout_swap() {
+
+  layout_active ^= 1;
+
+}
+
+// --------------------------------------------------
+
+void layout_select(uint8_t bank) {
+
+  if(bank >= LAYOUT_BANK_COUNT || bank == layout_bank()) {
+    return;
+  }
+
+  layout_stage(bank);
+  layout_swap();
+  ee_store_set(EE_STORE_KEY_BANK, &bank);
+
+}
+
+// --------------------------------------------------
+
+uint8_t layout_bank() {
+
+  return layout_table_bank[layout_active];
+
+}
+
+// --------------------------------------------------
+
+// Note to send for a pad press, recorded until its release
+uint8_t layout_press(uint8_t pad) {
+
+  uint8_t note = layout_table[layout_active][pad];
+  layout_held_note[pad] = note;
+
+  return note;
+
+}
+
+// --------------------------------------------------
+
+// Note sent at the pad's press, or LAYOUT_NOTE_NONE if none is held
+uint8_t layout_release(uint8_t pad) {
+
+  uint8_t note = layout_held_note[pad];
+  layout_held_note[pad] = LAYOUT_NOTE_NONE;
+
+  return note;
+
+}
+
+// --------------------------------------------------
+
+uint8_t layout_held(uint8_t pad) {
+
+  return layout_held_note[pad];
+
+}
+
+// --------------------------------------------------
+
+void layout_panic() {
+
+  for(uint8_t pad = 0; pad < BUTTON_COUNT; pad++) {
+    uint8_t note = layout_release(pad);
+    if(note == LAYOUT_NOTE_NONE) {
+      continue;
+    }
+    midi_timed_cancel(pad);
+    midi_sched_note_off(pad, note);
+  }
+
+}
@@ -0,0 +1,63 @@
+// Pad-to-note layout banks and held notes
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+/*
+ * Banks (FL Studio performance mode: one octave per pad row)
+ * - Bank 0: columns 0 ~ 5 of each octave
+ * - Bank 1: columns 6 ~ 11 of each octave
+ *
+ * - The mapping is double-buffered: layout_stage fills the idle table,
+ *   layout_swap makes it active with a single byte store, so a swap takes
+ *   constant time and a scan never sees a half-written table;
+ *   layout_select does both and saves the bank (refer to ee_store.h)
+ * - layout_press records the note sent for a pad, layout_release returns it
+ *   and clears it, so every release matches its press whatever the bank is
+ *   by then
+ * - layout_panic sends a note off for every held note, and only those
+ * - Only when built with LAYOUT_CHANNEL=<1 ~ 16>, received over MIDI in on
+ *   that channel (refer to midi_thru.h): program change selects bank
+ *   (program modulo LAYOUT_BANK_COUNT), all notes off (control change 123)
+ *   triggers a panic
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Number of banks
+#define LAYOUT_BANK_COUNT 2U
+
+// Note of a pad in a bank
+#define LAYOUT_NOTE(bank, index) ((((index) / 6) * 12) + ((bank) * 6) \
++ ((index) % 6))
+
+// No note held
+#define LAYOUT_NOTE_NONE 0xffU
+
+// --------------------------------------------------
+
+void layout_init();
+
+void layout_stage(uint8_t);
+
+void layout_swap();
+
+void layout_select(uint8_t);
+
+uint8_t layout_bank();
+
+uint8_t layout_press(uint8_t);
+
+uint8_t layout_release(uint8_t);
+
+uint8_t layout_held(uint8_t);
+
+void layout_panic();
+
+// --------------------------------------------------
+
+#endif
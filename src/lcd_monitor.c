@@ -0,0 +1,178 @@
+#include "common.h"
+#include "lcd_monitor.h"
+
+#ifdef LCD_MONITOR
+
+#include "button_snap.h"
+#include "input.h"
+#include "midi_sched.h"
+#include "text_lcd.h"
+#include "timer.h"
+
+#if INPUT_BACKEND != INPUT_BACKEND_MCP23017
+#error "LCD_MONITOR shares pins with this input backend"
+#endif
+
+// Pads per custom character, pads per row
+#define GLYPH_PADS 12U
+#define ROW_PADS 6U
+
+// Budget, and the longest a single write takes to send (timer ticks)
+#define BUDGET_TICKS (LCD_MONITOR_BUDGET_US / TIMER_US_PER_TICK)
+#define WRITE_TICKS 2U
+
+// No character being drawn
+#define GLYPH_NONE 0xffU
+
+// Pad bits never shown, so that every character is drawn once at start
+#define PADS_UNKNOWN 0xffffU
+
+// Start-up writes: controller initialization, DDRAM address, characters
+// 0 ~ 4 on the top line
+#define BOOT_INIT 0U
+#define BOOT_ADDRESS 1U
+#define BOOT_CHARS 2U
+#define BOOT_DONE (BOOT_CHARS + LCD_MONITOR_GLYPHS)
+
+// --------------------------------------------------
+
+// Pad bits per character: shown on the LCD, wanted
+uint16_t lcd_monitor_shown[LCD_MONITOR_GLYPHS];
+uint16_t lcd_monitor_want[LCD_MONITOR_GLYPHS];
+
+// Sequence number of the last state read
+uint8_t lcd_monitor_seq;
+
+// Next start-up write
+uint8_t lcd_monitor_boot;
+
+// Character being drawn, its pad bits, next write (0: address, 1 ~ 8: rows)
+uint8_t lcd_monitor_glyph;
+uint16_t lcd_monitor_drawing;
+uint8_t lcd_monitor_step;
+
+// --------------------------------------------------
+
+// Pixel row of a character for its pad bits
+uint8_t lcd_monitor_pixels(uint16_t pads, uint8_t row) {
+
+  uint8_t pixels = 0;
+
+  if(row < ROW_PADS) {
+    if(pads & (1 << row)) {
+      pixels |= 0x18;
+    }
+    if(pads & (1 << (row + ROW_PADS))) {
+      pixels |= 0x03;
+    }
+  }
+
+  return pixels;
+
+}
+
+// --------------------------------------------------
+
+void lcd_monitor_init() {
+
+  // Pins only; the LCD is brought up by lcd_monitor_service
+  text_lcd_init_post();
+  for(uint8_t glyph = 0; glyph < LCD_MONITOR_GLYPHS; glyph++) {
+    lcd_monitor_shown[glyph] = PADS_UNKNOWN;
+    lcd_monitor_want[glyph] = 0;
+  }
+
+  lcd_monitor_boot = BOOT_INIT;
+  lcd_monitor_seq = button_snap_seq(&button_snap_state);
+  lcd_monitor_glyph = GLYPH_NONE;
+
+}
+
+// --------------------------------------------------
+
+void lcd_monitor_service() {
+
+  uint16_t start = timer_read();
+
+  // Split new state into characters
+  if(button_snap_seq(&button_snap_state) != lcd_monitor_seq) {
+    uint8_t frame[BUTTON_STATE_BYTES];
+    lcd_monitor_seq = button_snap_read(&button_snap_state, frame);
+    for(uint8_t glyph = 0; glyph < LCD_MONITOR_GLYPHS; glyph++) {
+      uint8_t first = glyph * GLYPH_PADS;
+      uint16_t bits = frame[first / 8];
+      if((first / 8U) + 1U < BUTTON_STATE_BYTES) {
+        bits |= (uint16_t) frame[(first / 8) + 1] << 8;
+      }
+      lcd_monitor_want[glyph] = (bits >> (first % 8)) & 0x0fffU;
+    }
+  }
+
+  // LCD not powered up long enough to take instructions
+  if(lcd_monitor_boot == BOOT_INIT
+  && timer_read_long() < TEXT_LCD_POWER_UP_TICKS) {
+    return;
+  }
+
+  // Send writes while the next one still fits the budget
+  while((uint16_t) (timer_read() - start) + WRITE_TICKS <= BUDGET_TICKS) {
+
+    // Start-up writes first
+    if(lcd_monitor_boot < BOOT_DONE) {
+      if(!text_lcd_post_ready()) {
+        midi_sched_service();
+        continue;
+      }
+      if(lcd_monitor_boot == BOOT_INIT) {
+        if(text_lcd_post_init()) {
+          lcd_monitor_boot++;
+        }
+      } else if(lcd_monitor_boot == BOOT_ADDRESS) {
+        text_lcd_post_instr(TEXT_LCD_SET_DDRAM);
+        lcd_monitor_boot++;
+      } else {
+        text_lcd_post_char(lcd_monitor_boot - BOOT_CHARS);
+        lcd_monitor_boot++;
+      }
+      continue;
+    }
+
+    // Pick a character to redraw
+    if(lcd_monitor_glyph == GLYPH_NONE) {
+      for(uint8_t glyph = 0; glyph < LCD_MONITOR_GLYPHS; glyph++) {
+        if(lcd_monitor_want[glyph] != lcd_monitor_shown[glyph]) {
+          lcd_monitor_glyph = glyph;
+          lcd_monitor_drawing = lcd_monitor_want[glyph];
+          lcd_monitor_step = 0;
+          break;
+        }
+      }
+      if(lcd_monitor_glyph == GLYPH_NONE) {
+        return;
+      }
+    }
+
+    // Previous write still executing
+    if(!text_lcd_post_ready()) {
+      midi_sched_service();
+      continue;
+    }
+
+    if(!lcd_monitor_step) {
+      text_lcd_post_instr(TEXT_LCD_SET_CGRAM | (lcd_monitor_glyph << 3));
+    } else {
+      text_lcd_post_char(lcd_monitor_pixels(lcd_monitor_drawing,
+      lcd_monitor_step - 1));
+    }
+    lcd_monitor_step++;
+
+    if(lcd_monitor_step > 8) {
+      lcd_monitor_shown[lcd_monitor_glyph] = lcd_monitor_drawing;
+      lcd_monitor_glyph = GLYPH_NONE;
+    }
+
+  }
+
+}
+
+#endif
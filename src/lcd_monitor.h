@@ -0,0 +1,49 @@
+// Live pad state monitor on the text LCD
+
+#ifndef LCD_MONITOR_H
+#define LCD_MONITOR_H
+
+/*
+ * Opt-in; enabled by building with "make compile OPTS=-DLCD_MONITOR"
+ * - Shows the acknowledged state of all 10x6 pads (read from
+ *   button_snap_state) as custom characters 0 ~ 4, left of the top line
+ * - Each character covers two pad rows: pixel row n is pad column n, the
+ *   left two pixels the even pad row, the right two the odd one; the bottom
+ *   two pixel rows stay blank
+ * - Only characters whose pads changed are redrawn: one CGRAM address
+ *   instruction, then 8 row writes, each sent without waiting (refer to
+ *   text_lcd.h)
+ * - Nothing blocks at start: lcd_monitor_init only sets up pins; the LCD is
+ *   initialized, characters 0 ~ 4 placed and drawn by lcd_monitor_service
+ *   through the same writes, once the LCD has been powered for 40 ms
+ * - lcd_monitor_service runs once per scan, after MIDI output, and returns
+ *   before LCD_MONITOR_BUDGET_US has passed; while the LCD executes a write
+ *   it services queued MIDI output
+ * - Needs the text LCD's pins, so only builds with the MCP23017 input
+ *   backend (refer to input.h)
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Time allowed per call (microseconds)
+#ifndef LCD_MONITOR_BUDGET_US
+#define LCD_MONITOR_BUDGET_US 120U
+#endif
+
+// Custom characters used, pad rows per character
+#define LCD_MONITOR_GLYPHS 5U
+#define LCD_MONITOR_ROWS_PER_GLYPH 2U
+
+// --------------------------------------------------
+
+void lcd_monitor_init();
+
+void lcd_monitor_service();
+
+// --------------------------------------------------
+
+#endif
@@ -4,52 +4,61 @@
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
-#include "io_expand.h"
-#include "serial_midi.h"
+#include "button_snap.h"
+#include "debounce.h"
+#include "ee_store.h"
+#include "input.h"
+#include "layout.h"
+#include "lcd_monitor.h"
+#include "midi_sched.h"
+#include "midi_timed.h"
+#include "midi_thru.h"
+#include "profile.h"
+#include "scan_rate.h"
+#include "scan_watch.h"
+#include "timer.h"
 
 // --------------------------------------------------
 
 // Pre-processor definitions
 
-// Delay period at boot
-#define DELAY_INIT 1000U
-
 // Value for USART baud rate register (refer to formula in datasheet)
 // 103 for 9600 Hz, 31 for 31250 Hz
 #define USART_BAUD_VAL 31U
 
-// Number of buttons (60, round up to multiple of 8)
-#define BUTTON_COUNT 64U
-
-// Number of bytes used to hold button states
-#define BUTTON_STATE_BYTES 8U
-
-// Number of I/O expanders
-#define EXPANDER_COUNT 4U
-
-// Duration that new button state must hold to be acknowledged (iterations)
-#define BUTTON_ACK_DUR 2U
-
 // --------------------------------------------------
 
 // Global variables
 
+// Scan loop's private working copies; other consumers read button_snap_state
+
 // Button input states, live (before debouncing)
-volatile uint8_t button_state_pre[BUTTON_STATE_BYTES];
+uint8_t button_state_pre[BUTTON_STATE_BYTES];
 
 // Button input states, acknowledged (after debouncing)
-volatile uint8_t button_state[BUTTON_STATE_BYTES];
+uint8_t button_state[BUTTON_STATE_BYTES];
+
+// I/O expanders responding at boot (bit per expander)
+uint8_t expander_ready;
 
-// Number of loop iterations a button's unacknowledged state has held for
-volatile uint8_t button_unack_data[BUTTON_COUNT];
+// Time from timer start to input source ready (timer ticks)
+uint32_t boot_ticks;
+
+// Pad presses over the instrument's lifetime, persisted
+uint32_t usage_presses;
 
 // --------------------------------------------------
 
 int main() {
 
-  // Briefly pause before running any code to allow peripherals to reset
-  _delay_ms(DELAY_INIT);
+  // Start timer first; boot time is measured from here
+  timer_init();
+
+  // ----------------------------------------
+
+  // Load persisted settings before anything that uses them
+  ee_store_init();
+  ee_store_get(EE_STORE_KEY_USAGE, &usage_presses);
 
   // ----------------------------------------
 
@@ -58,9 +67,9 @@ int main() {
     button_state_pre[i] = 0;
     button_state[i] = 0;
   }
-  for(uint8_t i = 0; i < BUTTON_COUNT; i++) {
-    button_unack_data[i];
-  }
+  debounce_init();
+  button_snap_init(&button_snap_state);
+  layout_init();
 
   // ----------------------------------------
 
@@ -71,10 +80,19 @@ int main() {
 
   // ----------------------------------------
 
-  // Initialize TWI (I2C)
-  TWBR = 72;
-  PORTC |= (1 << PORTC4);
-  PORTC |= (1 << PORTC5);
+  // Initialize MIDI output schedulers
+  midi_sched_init();
+  midi_timed_init();
+#ifdef MIDI_CLOCK_BPM
+  midi_timed_tempo(MIDI_CLOCK_BPM);
+  midi_timed_clock_start();
+#endif
+#ifdef MIDI_REPEAT_CLOCKS
+  midi_timed_repeat(MIDI_REPEAT_CLOCKS);
+#endif
+
+  // Merge MIDI in with local output
+  midi_thru_init();
 
   // ----------------------------------------
 
@@ -85,65 +103,127 @@ int main() {
 
   // ----------------------------------------
 
-  // Initialize MCP23017's
-  for(uint8_t expander_index = 0; expander_index < EXPANDER_COUNT;
-  expander_index++) {
-    io_expand_init(expander_index);
-  }
+  // Timer overflow and timed MIDI events run in interrupts
+  sei();
+
+  // ----------------------------------------
+
+  // Initialize input source; returns as soon as every expander responds
+  expander_ready = input_init();
+  boot_ticks = timer_read_long();
+
+#ifdef LCD_MONITOR
+  // Pad state on the LCD
+  lcd_monitor_init();
+#endif
+
+  // Start pacing and supervising scans
+  scan_rate_init();
+  scan_watch_init();
+  PROFILE_BOOT(boot_ticks, expander_ready);
 
   // ----------------------------------------
 
   // Loop until poweroff
   while(1) {
 
-    // Update all buttons' live (pre-debounce) states
-    for(uint8_t expander_index = 0; expander_index < EXPANDER_COUNT;
-    expander_index++) {
-      uint16_t expander_data = io_expand_read_bytes(expander_index);
-      button_state_pre[expander_index * 2] = (uint8_t) (expander_data >> 8);
-      button_state_pre[(expander_index * 2) + 1] = (uint8_t) expander_data;
+    // Wait for this scan's slot at the current rate; debounce in wall-clock
+    // time
+    debounce_tick(scan_rate_begin());
+
+    scan_watch_begin();
+
+    // Read input groups while debouncing: the next group's transfer is in
+    // flight while the previous group is debounced and its MIDI events
+    // generated
+    PROFILE_BEGIN(PROFILE_PHASE_SCAN);
+    uint8_t input_read = input_changed();
+    if(input_read) {
+      input_read_start(0);
     }
+    uint8_t state_changed = 0;
+    uint8_t pending = 0;
+    for(uint8_t group = 0; group < INPUT_GROUP_COUNT; group++) {
+
+      // Update group's live (pre-debounce) states, start reading the next
+      if(input_read) {
+        PROFILE_BEGIN(PROFILE_PHASE_READ);
+        input_read_finish(group, button_state_pre);
+        PROFILE_END(PROFILE_PHASE_READ);
+        if(group + 1U < INPUT_GROUP_COUNT) {
+          input_read_start(group + 1);
+        }
+      }
 
-    // Iterate through all buttons' live states and update acknowledged states
-    for(uint8_t byte_index = 0; byte_index < BUTTON_STATE_BYTES; byte_index++) {
-      for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
-
-        // Information for current button
-        uint8_t button_index = byte_index * 8 + bit_index;
-        uint8_t curr_bit_pre
-        = (button_state_pre[byte_index] >> bit_index) & 0x01;
-        uint8_t curr_bit = (button_state[byte_index] >> bit_index) & 0x01;
-
-        // If button's live state does not match acknowledged state
-        if(curr_bit_pre != curr_bit) {
-          // If unacknowledged state has held long enough
-          if(button_unack_data[button_index] >= BUTTON_ACK_DUR) {
-            // Clear unacknowledged state
-            button_unack_data[button_index] = 0;
-            // Flip button state and generate MIDI event
-            uint8_t note = ((button_index / 6) * 12) + (button_index % 6);
-            if(curr_bit) {
-              button_state[byte_index] &= ~(1 << bit_index);
-              serial_midi_note_off(note);
-            } else {
-              button_state[byte_index] |= (1 << bit_index);
-              serial_midi_note_on(note, 127);
-            }
-          }
-          // If unacknowledged state has not yet held long enough
-          else {
-            button_unack_data[button_index]++;
-          }
+      // Iterate through group's live states and update acknowledged states
+      PROFILE_BEGIN(PROFILE_PHASE_DEBOUNCE);
+      for(uint8_t byte_index = group * INPUT_GROUP_BYTES;
+      byte_index < (group + 1) * INPUT_GROUP_BYTES; byte_index++) {
+
+        // Buttons with an edge being debounced keep the scan rate up
+        pending |= button_state_pre[byte_index] ^ button_state[byte_index];
+
+        // Buttons whose new state has held long enough
+        uint8_t flip = debounce_byte(byte_index, button_state_pre[byte_index],
+        button_state[byte_index]);
+        if(!flip) {
+          continue;
         }
+        button_state[byte_index] ^= flip;
+        state_changed = 1;
 
-        // If button's live state matches acknowledged state
-        else {
-          // Clear unacknowledged state
-          button_unack_data[button_index] = 0;
+        // Generate MIDI events
+        for(uint8_t bit_index = 0; bit_index < 8; bit_index++) {
+          if(!((flip >> bit_index) & 0x01)) {
+            continue;
+          }
+          uint8_t button_index = byte_index * 8 + bit_index;
+          if((button_state[byte_index] >> bit_index) & 0x01) {
+            uint8_t note = layout_press(button_index);
+            midi_sched_note_on(button_index, note, 127);
+            usage_presses++;
+            ee_store_set(EE_STORE_KEY_USAGE, &usage_presses);
+          } else {
+            // Release the note actually sent, whatever the bank is now
+            uint8_t note = layout_release(button_index);
+            midi_timed_cancel(button_index);
+            if(note != LAYOUT_NOTE_NONE) {
+              midi_sched_note_off(button_index, note);
+            }
+          }
         }
 
       }
+      PROFILE_END(PROFILE_PHASE_DEBOUNCE);
+
+    }
+    debounce_service();
+    ee_store_service();
+
+    // Publish complete acknowledged state for other consumers
+    if(state_changed) {
+      button_snap_publish(&button_snap_state, button_state);
     }
+    PROFILE_END(PROFILE_PHASE_SCAN);
+
+    // Schedule note repeats, transmit queued MIDI events, note ons first
+    PROFILE_BEGIN(PROFILE_PHASE_MIDI);
+    midi_thru_service();
+    midi_timed_service();
+    midi_sched_service();
+    PROFILE_END(PROFILE_PHASE_MIDI);
+
+#ifdef LCD_MONITOR
+    // Redraw changed pads, within a fixed time budget
+    PROFILE_BEGIN(PROFILE_PHASE_LCD);
+    lcd_monitor_service();
+    PROFILE_END(PROFILE_PHASE_LCD);
+#endif
+
+    scan_watch_end();
+    scan_rate_end(pending, input_read);
+
+    PROFILE_LOOP();
 
   }
 
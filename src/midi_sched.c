@@ -0,0 +1,605 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "midi_sched.h"
+#include "midi_timed.h"
+#include "serial_midi.h"
+#include "timer.h"
+
+// Queue capacity per class (power of 2)
+#define QUEUE_LEN 16U
+#define QUEUE_MASK (QUEUE_LEN - 1U)
+
+#define STATUS_NOTE_OFF 0x80U
+#define STATUS_NOTE_ON 0x90U
+#define STATUS_CONTROL 0xb0U
+#define VELOCITY_NOTE_OFF 0x40U
+
+// Classes queued in ring buffers; the controller class has its slots
+#define RING_CLASSES MIDI_SCHED_CLASS_CC
+
+// Token bucket cost of one message (timer ticks), 0 if not limited
+#define COST(rate) ((rate) ? (1000000UL / TIMER_US_PER_TICK) / (rate) : 0)
+
+// Status value of a cancelled event
+#define STATUS_CANCELLED 0x00U
+
+// --------------------------------------------------
+
+// Queued message
+struct midi_sched_event {
+  uint8_t pad;
+  uint8_t msg[3];
+  uint16_t stamp;
+};
+
+// Per-class ring buffers
+struct midi_sched_event midi_sched_queue[RING_CLASSES][QUEUE_LEN];
+uint8_t midi_sched_head[RING_CLASSES];
+uint8_t midi_sched_count[RING_CLASSES];
+
+// Latest unsent value per controller, next slot to send, slots in use
+struct midi_sched_event midi_sched_cc_slot[MIDI_SCHED_CC_SLOTS];
+uint8_t midi_sched_cc_next;
+uint8_t midi_sched_cc_count;
+
+// Token buckets (timer ticks of credit), time of last refill
+const uint16_t midi_sched_cost[MIDI_SCHED_CLASS_COUNT] = {
+  0, 0, COST(MIDI_SCHED_RATE_STATUS), COST(MIDI_SCHED_RATE_THRU),
+  COST(MIDI_SCHED_RATE_CC)
+};
+uint32_t midi_sched_credit[MIDI_SCHED_CLASS_COUNT];
+uint32_t midi_sched_refill_time;
+
+// Message currently being transmitted
+volatile uint8_t midi_sched_tx_msg[3];
+volatile uint8_t midi_sched_tx_len;
+volatile uint8_t midi_sched_tx_pos;
+
+// Status byte of the last channel message sent, 0 if none or cancelled
+uint8_t midi_sched_tx_status;
+
+// Message slots taken by other classes while thru messages were queued
+uint8_t midi_sched_thru_wait;
+
+// Real-time byte waiting for the next byte slot, 0 if none
+volatile uint8_t midi_sched_rt_byte;
+
+// Timed message that missed its slot, sent at the next message boundary
+volatile uint8_t midi_sched_late_msg[3];
+volatile uint8_t midi_sched_late_len;
+
+// Worst-case time from queueing to start of transmission (timer ticks)
+uint16_t midi_sched_delay_worst[MIDI_SCHED_CLASS_COUNT];
+
+// Statistics: bytes sent since the reset time, controller values coalesced
+// and dropped
+volatile uint32_t midi_sched_tx_bytes;
+uint32_t midi_sched_stat_time;
+uint16_t midi_sched_cc_coalesced;
+uint16_t midi_sched_cc_dropped;
+
+// --------------------------------------------------
+
+void midi_sched_init() {
+
+  for(uint8_t class = 0; class < RING_CLASSES; class++) {
+    midi_sched_head[class] = 0;
+    midi_sched_count[class] = 0;
+  }
+  for(uint8_t slot = 0; slot < MIDI_SCHED_CC_SLOTS; slot++) {
+    midi_sched_cc_slot[slot].msg[0] = STATUS_CANCELLED;
+  }
+  midi_sched_cc_next = 0;
+  midi_sched_cc_count = 0;
+  for(uint8_t class = 0; class < MIDI_SCHED_CLASS_COUNT; class++) {
+    midi_sched_credit[class]
+    = (uint32_t) midi_sched_cost[class] * MIDI_SCHED_BURST;
+    midi_sched_delay_worst[class] = 0;
+  }
+  midi_sched_refill_time = timer_read_long();
+  midi_sched_stat_reset();
+  midi_sched_tx_len = 0;
+  midi_sched_tx_pos = 0;
+  midi_sched_tx_status = 0;
+  midi_sched_thru_wait = 0;
+  midi_sched_rt_byte = 0;
+  midi_sched_late_len = 0;
+
+}
+
+// --------------------------------------------------
+
+// Find the oldest live event for a pad in a class, or return 0
+struct midi_sched_event * midi_sched_find(uint8_t class, uint8_t pad) {
+
+  for(uint8_t i = 0; i < midi_sched_count[class]; i++) {
+    struct midi_sched_event *event
+    = &midi_sched_queue[class][(midi_sched_head[class] + i) & QUEUE_MASK];
+    if(event->pad == pad && event->msg[0] != STATUS_CANCELLED) {
+      return event;
+    }
+  }
+
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+// Find the newest live event for a pad in a class, or return 0
+struct midi_sched_event * midi_sched_find_last(uint8_t class, uint8_t pad) {
+
+  struct midi_sched_event *found = 0;
+  for(uint8_t i = 0; i < midi_sched_count[class]; i++) {
+    struct midi_sched_event *event
+    = &midi_sched_queue[class][(midi_sched_head[class] + i) & QUEUE_MASK];
+    if(event->pad == pad && event->msg[0] != STATUS_CANCELLED) {
+      found = event;
+    }
+  }
+
+  return found;
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_push(uint8_t class, uint8_t pad, uint8_t status, uint8_t data1,
+uint8_t data2) {
+
+  // Never drop a message; drain the link until the class has room
+  while(midi_sched_count[class] >= QUEUE_LEN) {
+    midi_sched_service();
+  }
+
+  struct midi_sched_event *event = &midi_sched_queue[class]
+  [(midi_sched_head[class] + midi_sched_count[class]) & QUEUE_MASK];
+  event->pad = pad;
+  event->msg[0] = status;
+  event->msg[1] = data1;
+  event->msg[2] = data2;
+  event->stamp = timer_read();
+  midi_sched_count[class]++;
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_note_on(uint8_t pad, uint8_t note, uint8_t velocity) {
+
+  struct midi_sched_event *release
+  = midi_sched_find(MIDI_SCHED_CLASS_NOTE_OFF, pad);
+
+  note &= 0x7fU;
+  if(release) {
+    // Previous press of the same note never went out either: the release
+    // and this press cancel out, leaving the queued press
+    struct midi_sched_event *press
+    = midi_sched_find_last(MIDI_SCHED_CLASS_NOTE_ON, pad);
+    if(press && press->msg[1] == note) {
+      release->msg[0] = STATUS_CANCELLED;
+      return;
+    }
+    // Otherwise the release has to precede this press
+    midi_sched_push(MIDI_SCHED_CLASS_NOTE_ON, pad, release->msg[0],
+    release->msg[1], release->msg[2]);
+    release->msg[0] = STATUS_CANCELLED;
+  }
+
+  midi_sched_push(MIDI_SCHED_CLASS_NOTE_ON, pad, STATUS_NOTE_ON, note,
+  velocity & 0x7fU);
+
+}
+
+// --------------------------------------------------
+
+// Return 1 if a note on for a pad is still waiting to be sent
+uint8_t midi_sched_pending(uint8_t pad) {
+
+  return midi_sched_find(MIDI_SCHED_CLASS_NOTE_ON, pad) != 0;
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_note_off(uint8_t pad, uint8_t note) {
+
+  midi_sched_push(MIDI_SCHED_CLASS_NOTE_OFF, pad, STATUS_NOTE_OFF,
+  note & 0x7fU, VELOCITY_NOTE_OFF);
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_status(uint8_t status, uint8_t data1, uint8_t data2) {
+
+  midi_sched_push(MIDI_SCHED_CLASS_STATUS, MIDI_SCHED_NO_PAD, status,
+  data1 & 0x7fU, data2 & 0x7fU);
+
+}
+
+// --------------------------------------------------
+
+// Queue a forwarded message; return 1 if dropped because the queue is full
+uint8_t midi_sched_thru(uint8_t status, uint8_t data1, uint8_t data2) {
+
+  if(midi_sched_count[MIDI_SCHED_CLASS_THRU] >= QUEUE_LEN) {
+    return 1;
+  }
+  midi_sched_push(MIDI_SCHED_CLASS_THRU, MIDI_SCHED_NO_PAD, status, data1,
+  data2);
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+// Set a controller's latest value; return 1 if dropped because every slot
+// holds another controller's unsent value
+uint8_t midi_sched_cc(uint8_t channel, uint8_t controller, uint8_t value) {
+
+  uint8_t status = STATUS_CONTROL | (channel & 0x0fU);
+  struct midi_sched_event *free = 0;
+
+  controller &= 0x7fU;
+  value &= 0x7fU;
+
+  for(uint8_t slot = 0; slot < MIDI_SCHED_CC_SLOTS; slot++) {
+    struct midi_sched_event *event = &midi_sched_cc_slot[slot];
+    // Unsent value: replace it, keeping its place and age
+    if(event->msg[0] == status && event->msg[1] == controller) {
+      event->msg[2] = value;
+      if(midi_sched_cc_coalesced < 0xffffU) {
+        midi_sched_cc_coalesced++;
+      }
+      return 0;
+    }
+    if(!free && event->msg[0] == STATUS_CANCELLED) {
+      free = event;
+    }
+  }
+
+  if(!free) {
+    if(midi_sched_cc_dropped < 0xffffU) {
+      midi_sched_cc_dropped++;
+    }
+    return 1;
+  }
+  free->pad = MIDI_SCHED_NO_PAD;
+  free->msg[0] = status;
+  free->msg[1] = controller;
+  free->msg[2] = value;
+  free->stamp = timer_read();
+  midi_sched_cc_count++;
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+// Whether a class's bucket holds a token
+uint8_t midi_sched_token(uint8_t class) {
+
+  return midi_sched_credit[class] >= midi_sched_cost[class];
+
+}
+
+// --------------------------------------------------
+
+// Oldest live event of the highest priority class with a token, or 0 if none
+// is queued
+struct midi_sched_event * midi_sched_next(uint8_t *class_out) {
+
+  // Thru messages' share of the link
+  if(midi_sched_count[MIDI_SCHED_CLASS_THRU]
+  && midi_sched_thru_wait >= MIDI_SCHED_THRU_SHARE - 1U
+  && midi_sched_token(MIDI_SCHED_CLASS_THRU)) {
+    *class_out = MIDI_SCHED_CLASS_THRU;
+    return &midi_sched_queue[MIDI_SCHED_CLASS_THRU]
+    [midi_sched_head[MIDI_SCHED_CLASS_THRU]];
+  }
+
+  for(uint8_t class = 0; class < RING_CLASSES; class++) {
+    if(!midi_sched_token(class)) {
+      continue;
+    }
+    while(midi_sched_count[class]) {
+      struct midi_sched_event *event
+      = &midi_sched_queue[class][midi_sched_head[class]];
+      if(event->msg[0] != STATUS_CANCELLED) {
+        *class_out = class;
+        return event;
+      }
+      midi_sched_head[class] = (midi_sched_head[class] + 1) & QUEUE_MASK;
+      midi_sched_count[class]--;
+    }
+  }
+
+  // Controllers, round robin
+  if(midi_sched_cc_count && midi_sched_token(MIDI_SCHED_CLASS_CC)) {
+    uint8_t slot = midi_sched_cc_next;
+    for(uint8_t i = 0; i < MIDI_SCHED_CC_SLOTS; i++) {
+      if(midi_sched_cc_slot[slot].msg[0] != STATUS_CANCELLED) {
+        *class_out = MIDI_SCHED_CLASS_CC;
+        return &midi_sched_cc_slot[slot];
+      }
+      slot = (slot + 1) & (MIDI_SCHED_CC_SLOTS - 1U);
+    }
+  }
+
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+// Send a byte and count it
+void midi_sched_tx(uint8_t data) {
+
+  serial_midi_tx_byte(data);
+  midi_sched_tx_bytes++;
+
+}
+
+// --------------------------------------------------
+
+// Send the first byte of the message in midi_sched_tx_msg; called with
+// interrupts disabled and the data register empty
+void midi_sched_start(uint8_t len) {
+
+  midi_sched_tx_len = len;
+
+#ifdef MIDI_RUNNING_STATUS
+  uint8_t status = midi_sched_tx_msg[0];
+  if(status < 0xf0U) {
+    if(status == midi_sched_tx_status) {
+      midi_sched_tx(midi_sched_tx_msg[1]);
+      midi_sched_tx_pos = 2;
+      return;
+    }
+    midi_sched_tx_status = status;
+  } else {
+    midi_sched_tx_status = 0;
+  }
+#endif
+
+  midi_sched_tx(midi_sched_tx_msg[0]);
+  midi_sched_tx_pos = 1;
+
+}
+
+// --------------------------------------------------
+
+// Transmit at most one byte; called with interrupts disabled
+uint8_t midi_sched_step() {
+
+  if(!serial_midi_tx_ready()) {
+    return 0;
+  }
+
+  // Real-time bytes may go between any two bytes
+  if(midi_sched_rt_byte) {
+    midi_sched_tx(midi_sched_rt_byte);
+    midi_sched_rt_byte = 0;
+    return 1;
+  }
+
+  // Continue message in flight, unless a real-time event needs the line
+  if(midi_sched_tx_pos < midi_sched_tx_len) {
+    if(midi_timed_holdoff(1, 0)) {
+      return 0;
+    }
+    midi_sched_tx(midi_sched_tx_msg[midi_sched_tx_pos]);
+    midi_sched_tx_pos++;
+    return 1;
+  }
+
+  // Start next message: late timed message first, then queued by class
+  uint8_t len;
+  if(midi_sched_late_len) {
+    for(uint8_t i = 0; i < 3; i++) {
+      midi_sched_tx_msg[i] = midi_sched_late_msg[i];
+    }
+    len = midi_sched_late_len;
+    midi_sched_late_len = 0;
+  } else {
+    uint8_t class;
+    struct midi_sched_event *event = midi_sched_next(&class);
+    if(!event) {
+      return 0;
+    }
+    len = serial_midi_msg_len(event->msg[0]);
+    // Leave the line idle for a timed event due before this one would end
+    if(midi_timed_holdoff(len, 1)) {
+      return 0;
+    }
+
+    uint16_t delay = timer_read() - event->stamp;
+    if(delay > midi_sched_delay_worst[class]) {
+      midi_sched_delay_worst[class] = delay;
+    }
+
+    if(class == MIDI_SCHED_CLASS_THRU) {
+      midi_sched_thru_wait = 0;
+    } else if(midi_sched_count[MIDI_SCHED_CLASS_THRU]
+    && midi_sched_thru_wait < MIDI_SCHED_THRU_SHARE) {
+      midi_sched_thru_wait++;
+    }
+    midi_sched_credit[class] -= midi_sched_cost[class];
+
+    for(uint8_t i = 0; i < 3; i++) {
+      midi_sched_tx_msg[i] = event->msg[i];
+    }
+    if(class == MIDI_SCHED_CLASS_CC) {
+      event->msg[0] = STATUS_CANCELLED;
+      midi_sched_cc_next = ((event - midi_sched_cc_slot) + 1)
+      & (MIDI_SCHED_CC_SLOTS - 1U);
+      midi_sched_cc_count--;
+    } else {
+      midi_sched_head[class] = (midi_sched_head[class] + 1) & QUEUE_MASK;
+      midi_sched_count[class]--;
+    }
+  }
+
+  midi_sched_start(len);
+  return 1;
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_service() {
+
+  uint8_t sent;
+
+  // Refill token buckets
+  uint32_t now = timer_read_long();
+  uint32_t elapsed = now - midi_sched_refill_time;
+  midi_sched_refill_time = now;
+  for(uint8_t class = 0; class < MIDI_SCHED_CLASS_COUNT; class++) {
+    uint32_t full = (uint32_t) midi_sched_cost[class] * MIDI_SCHED_BURST;
+    if(elapsed >= full - midi_sched_credit[class]) {
+      midi_sched_credit[class] = full;
+    } else {
+      midi_sched_credit[class] += elapsed;
+    }
+  }
+
+  do {
+    uint8_t sreg = SREG;
+    cli();
+    sent = midi_sched_step();
+    SREG = sreg;
+  } while(sent);
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_flush() {
+
+  while(midi_sched_tx_pos < midi_sched_tx_len || midi_sched_rt_byte
+  || midi_sched_late_len
+  || midi_sched_count[MIDI_SCHED_CLASS_NOTE_ON]
+  || midi_sched_count[MIDI_SCHED_CLASS_NOTE_OFF]
+  || midi_sched_count[MIDI_SCHED_CLASS_STATUS]
+  || midi_sched_count[MIDI_SCHED_CLASS_THRU] || midi_sched_cc_count) {
+    midi_sched_service();
+  }
+
+}
+
+// --------------------------------------------------
+
+uint8_t midi_sched_inject(uint8_t status, uint8_t data1, uint8_t data2) {
+
+  uint8_t len = serial_midi_msg_len(status);
+
+  // At a message boundary with the line free: start right away
+  if(midi_sched_tx_pos >= midi_sched_tx_len && !midi_sched_rt_byte
+  && !midi_sched_late_len && serial_midi_tx_ready()) {
+    midi_sched_tx_msg[0] = status;
+    midi_sched_tx_msg[1] = data1;
+    midi_sched_tx_msg[2] = data2;
+    midi_sched_start(len);
+    return MIDI_SCHED_SENT;
+  }
+
+  // Otherwise go out at the next boundary, ahead of everything queued
+  if(!midi_sched_late_len) {
+    midi_sched_late_msg[0] = status;
+    midi_sched_late_msg[1] = data1;
+    midi_sched_late_msg[2] = data2;
+    midi_sched_late_len = len;
+    return MIDI_SCHED_LATE;
+  }
+
+  return MIDI_SCHED_BUSY;
+
+}
+
+// --------------------------------------------------
+
+uint8_t midi_sched_realtime(uint8_t data) {
+
+  if(midi_sched_rt_byte) {
+    return MIDI_SCHED_BUSY;
+  }
+  if(serial_midi_tx_ready()) {
+    midi_sched_tx(data);
+    return MIDI_SCHED_SENT;
+  }
+  midi_sched_rt_byte = data;
+  return MIDI_SCHED_LATE;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_sched_delay_max(uint8_t class) {
+
+  return midi_sched_delay_worst[class];
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_delay_reset() {
+
+  for(uint8_t class = 0; class < MIDI_SCHED_CLASS_COUNT; class++) {
+    midi_sched_delay_worst[class] = 0;
+  }
+
+}
+
+// --------------------------------------------------
+
+// Link utilisation since the last reset (parts per thousand)
+uint16_t midi_sched_stat_util() {
+
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t bytes = midi_sched_tx_bytes;
+  SREG = sreg;
+
+  uint32_t ticks = (timer_read_long() - midi_sched_stat_time) / 1000U;
+  if(!ticks) {
+    return 0;
+  }
+  uint32_t util = bytes * MIDI_TIMED_BYTE_TICKS / ticks;
+
+  return (util > 1000U) ? 1000U : (uint16_t) util;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_sched_stat_coalesced() {
+
+  return midi_sched_cc_coalesced;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_sched_stat_dropped() {
+
+  return midi_sched_cc_dropped;
+
+}
+
+// --------------------------------------------------
+
+void midi_sched_stat_reset() {
+
+  uint8_t sreg = SREG;
+  cli();
+  midi_sched_tx_bytes = 0;
+  SREG = sreg;
+
+  midi_sched_stat_time = timer_read_long();
+  midi_sched_cc_coalesced = 0;
+  midi_sched_cc_dropped = 0;
+
+}
@@ -0,0 +1,131 @@
+// Prioritized MIDI output scheduler
+
+#ifndef MIDI_SCHED_H
+#define MIDI_SCHED_H
+
+/*
+ * Sits between debouncing and the USART. Messages are queued per class and
+ * fed to the USART one byte at a time whenever its data register is empty, so
+ * the scan loop never waits on the 31250 baud link. A message is always sent
+ * whole; the next one is picked by class, then by age:
+ * - Note on
+ * - Note off
+ * - Status (any other message, including debug)
+ * - Thru (messages forwarded from MIDI in, refer to midi_thru.h)
+ * - Controller (control changes, coalesced)
+ *
+ * Bandwidth: every class but notes has a token bucket holding up to
+ * MIDI_SCHED_BURST messages, refilled at the class's rate in messages per
+ * second; a class with an empty bucket is passed over until it refills, so
+ * continuous traffic can never take the link from notes.
+ *
+ * Control changes are not queued: midi_sched_cc keeps only the latest value
+ * per channel and controller, in MIDI_SCHED_CC_SLOTS slots sent round robin
+ * as tokens allow. A value replacing an unsent one is counted as coalesced; a
+ * new controller finding every slot taken is dropped and counted.
+ *
+ * Thru messages are never waited for: when their queue is full, new ones are
+ * dropped. While any are queued, every MIDI_SCHED_THRU_SHARE-th message slot
+ * goes to the oldest, so a local message waits for at most the message in
+ * flight, one forwarded message and the local messages ahead of it, and
+ * forwarded messages are not starved by steady local traffic.
+ *
+ * Coalescing, per pad:
+ * - Release queued while the press is still queued: both are kept, the press
+ *   always goes out first
+ * - Press queued while a release is still queued: the release is promoted to
+ *   note on priority and sent immediately before the press
+ * - Press queued while both the previous press and release of the same note
+ *   are still queued: the release and the new press cancel out; a different
+ *   note (e.g. after a layout change) is queued after the release as usual
+ *
+ * Timed output (refer to midi_timed.h), called from its interrupt:
+ * - midi_sched_realtime sends a real-time byte now, or between the next two
+ *   bytes if the data register is full
+ * - midi_sched_inject starts a message now if at a message boundary,
+ *   otherwise at the next boundary ahead of all queued messages
+ * - The service routine leaves the line idle ahead of a timed event due
+ *   before the byte or message it would start could finish
+ *
+ * Link utilisation is measured as bytes sent, at 320 us each, over the time
+ * since the statistics were reset, in parts per thousand.
+ *
+ * Building with MIDI_RUNNING_STATUS leaves out a channel message's status
+ * byte when it matches the previous one sent; system common messages cancel
+ * it, real-time bytes do not.
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Message classes, highest priority first
+#define MIDI_SCHED_CLASS_NOTE_ON 0U
+#define MIDI_SCHED_CLASS_NOTE_OFF 1U
+#define MIDI_SCHED_CLASS_STATUS 2U
+#define MIDI_SCHED_CLASS_THRU 3U
+#define MIDI_SCHED_CLASS_CC 4U
+#define MIDI_SCHED_CLASS_COUNT 5U
+
+// Token bucket rates (messages per second, at least 4; 0: not limited) and
+// size (messages)
+#define MIDI_SCHED_RATE_STATUS 500U
+#define MIDI_SCHED_RATE_THRU 800U
+#define MIDI_SCHED_RATE_CC 250U
+#define MIDI_SCHED_BURST 4U
+
+// Controllers with a value waiting at once (power of 2)
+#define MIDI_SCHED_CC_SLOTS 16U
+
+// Message slots per forwarded message while any are queued
+#define MIDI_SCHED_THRU_SHARE 4U
+
+// Pad index for messages not tied to a pad
+#define MIDI_SCHED_NO_PAD 0xffU
+
+// Results of timed output
+#define MIDI_SCHED_SENT 0U
+#define MIDI_SCHED_LATE 1U
+#define MIDI_SCHED_BUSY 2U
+
+// --------------------------------------------------
+
+void midi_sched_init();
+
+void midi_sched_note_on(uint8_t, uint8_t, uint8_t);
+
+uint8_t midi_sched_pending(uint8_t);
+
+void midi_sched_note_off(uint8_t, uint8_t);
+
+void midi_sched_status(uint8_t, uint8_t, uint8_t);
+
+uint8_t midi_sched_thru(uint8_t, uint8_t, uint8_t);
+
+uint8_t midi_sched_cc(uint8_t, uint8_t, uint8_t);
+
+void midi_sched_service();
+
+void midi_sched_flush();
+
+uint8_t midi_sched_inject(uint8_t, uint8_t, uint8_t);
+
+uint8_t midi_sched_realtime(uint8_t);
+
+uint16_t midi_sched_delay_max(uint8_t);
+
+void midi_sched_delay_reset();
+
+uint16_t midi_sched_stat_util();
+
+uint16_t midi_sched_stat_coalesced();
+
+uint16_t midi_sched_stat_dropped();
+
+void midi_sched_stat_reset();
+
+// --------------------------------------------------
+
+#endif
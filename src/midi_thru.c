@@ -0,0 +1,244 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "midi_sched.h"
+#include "midi_thru.h"
+#include "serial_midi.h"
+
+#ifdef LAYOUT_CHANNEL
+#include "layout.h"
+#endif
+
+#define RX_MASK (MIDI_THRU_RX_LEN - 1U)
+
+#define STATUS_SYSEX 0xf0U
+#define STATUS_SYSEX_END 0xf7U
+#define STATUS_REALTIME 0xf8U
+#define STATUS_CONTROL 0xb0U
+#define STATUS_PROGRAM 0xc0U
+#define CONTROL_ALL_NOTES_OFF 123U
+
+// --------------------------------------------------
+
+// Receive ring buffer; head written by the interrupt, tail by the parser
+volatile uint8_t midi_thru_rx[MIDI_THRU_RX_LEN];
+volatile uint8_t midi_thru_rx_head;
+volatile uint8_t midi_thru_rx_tail;
+
+// Bytes lost since the parser last looked
+volatile uint8_t midi_thru_rx_lost;
+
+// Parser state: running status (0 if none), message being assembled
+uint8_t midi_thru_running;
+uint8_t midi_thru_msg[3];
+uint8_t midi_thru_pos;
+uint8_t midi_thru_len;
+uint8_t midi_thru_in_sysex;
+
+// Statistics; real-time bytes are counted by the interrupt
+uint16_t midi_thru_forwarded;
+uint16_t midi_thru_dropped;
+uint16_t midi_thru_sysex;
+volatile uint16_t midi_thru_rt_forwarded;
+volatile uint16_t midi_thru_rt_dropped;
+
+// --------------------------------------------------
+
+ISR(USART_RX_vect) {
+
+  uint8_t error = UCSR0A & ((1 << FE0) | (1 << DOR0));
+  uint8_t data = UDR0;
+
+  if(error) {
+    midi_thru_rx_lost = 1;
+    return;
+  }
+
+  if(data >= STATUS_REALTIME) {
+    if(midi_sched_realtime(data) == MIDI_SCHED_BUSY) {
+      midi_thru_rt_dropped++;
+    } else {
+      midi_thru_rt_forwarded++;
+    }
+    return;
+  }
+
+  uint8_t head = midi_thru_rx_head;
+  uint8_t next = (head + 1) & RX_MASK;
+  if(next == midi_thru_rx_tail) {
+    midi_thru_rx_lost = 1;
+    return;
+  }
+  midi_thru_rx[head] = data;
+  midi_thru_rx_head = next;
+
+}
+
+// --------------------------------------------------
+
+void midi_thru_init() {
+
+  midi_thru_rx_head = 0;
+  midi_thru_rx_tail = 0;
+  midi_thru_rx_lost = 0;
+  midi_thru_running = 0;
+  midi_thru_pos = 0;
+  midi_thru_len = 0;
+  midi_thru_in_sysex = 0;
+  midi_thru_stat_reset();
+
+  // Enable receiver and its interrupt; frame format is shared with output
+  UCSR0B |= (1 << RXEN0) | (1 << RXCIE0);
+
+}
+
+// --------------------------------------------------
+
+// Act on and queue a complete message
+void midi_thru_emit() {
+
+#ifdef LAYOUT_CHANNEL
+  // Foot controller on its own channel: program change selects the pad bank,
+  // all notes off releases held pads (refer to layout.h)
+  if(midi_thru_msg[0] == (STATUS_PROGRAM | (LAYOUT_CHANNEL - 1U))) {
+    layout_select(midi_thru_msg[1] % LAYOUT_BANK_COUNT);
+  } else if(midi_thru_msg[0] == (STATUS_CONTROL | (LAYOUT_CHANNEL - 1U))
+  && midi_thru_msg[1] == CONTROL_ALL_NOTES_OFF) {
+    layout_panic();
+  }
+#endif
+
+  if(midi_sched_thru(midi_thru_msg[0], midi_thru_msg[1], midi_thru_msg[2])) {
+    midi_thru_dropped++;
+  } else {
+    midi_thru_forwarded++;
+  }
+  midi_thru_pos = 0;
+
+}
+
+// --------------------------------------------------
+
+void midi_thru_parse(uint8_t data) {
+
+  // Status byte
+  if(data & 0x80U) {
+    // Unfinished message
+    if(midi_thru_pos) {
+      midi_thru_dropped++;
+      midi_thru_pos = 0;
+    }
+    if(data == STATUS_SYSEX) {
+      midi_thru_in_sysex = 1;
+      midi_thru_running = 0;
+      midi_thru_sysex++;
+      return;
+    }
+    midi_thru_in_sysex = 0;
+    if(data == STATUS_SYSEX_END) {
+      return;
+    }
+    // Only channel messages set running status; system common clears it
+    midi_thru_running = (data < STATUS_SYSEX) ? data : 0;
+    midi_thru_msg[0] = data;
+    midi_thru_msg[1] = 0;
+    midi_thru_msg[2] = 0;
+    midi_thru_len = serial_midi_msg_len(data);
+    midi_thru_pos = 1;
+    if(midi_thru_len == 1) {
+      midi_thru_emit();
+    }
+    return;
+  }
+
+  // Data byte
+  if(midi_thru_in_sysex) {
+    return;
+  }
+  if(!midi_thru_pos) {
+    if(!midi_thru_running) {
+      midi_thru_dropped++;
+      return;
+    }
+    midi_thru_msg[0] = midi_thru_running;
+    midi_thru_msg[2] = 0;
+    midi_thru_len = serial_midi_msg_len(midi_thru_running);
+    midi_thru_pos = 1;
+  }
+  midi_thru_msg[midi_thru_pos] = data;
+  midi_thru_pos++;
+  if(midi_thru_pos >= midi_thru_len) {
+    midi_thru_emit();
+  }
+
+}
+
+// --------------------------------------------------
+
+void midi_thru_service() {
+
+  // Resynchronize on the next status byte after lost input
+  if(midi_thru_rx_lost) {
+    midi_thru_rx_lost = 0;
+    midi_thru_dropped++;
+    midi_thru_running = 0;
+    midi_thru_pos = 0;
+  }
+
+  uint8_t tail = midi_thru_rx_tail;
+  while(tail != midi_thru_rx_head) {
+    midi_thru_parse(midi_thru_rx[tail]);
+    tail = (tail + 1) & RX_MASK;
+    midi_thru_rx_tail = tail;
+  }
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_thru_stat_forwarded() {
+
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t forwarded = midi_thru_forwarded + midi_thru_rt_forwarded;
+  SREG = sreg;
+
+  return forwarded;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_thru_stat_dropped() {
+
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t dropped = midi_thru_dropped + midi_thru_rt_dropped;
+  SREG = sreg;
+
+  return dropped;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_thru_stat_sysex() {
+
+  return midi_thru_sysex;
+
+}
+
+// --------------------------------------------------
+
+void midi_thru_stat_reset() {
+
+  uint8_t sreg = SREG;
+  cli();
+  midi_thru_forwarded = 0;
+  midi_thru_dropped = 0;
+  midi_thru_sysex = 0;
+  midi_thru_rt_forwarded = 0;
+  midi_thru_rt_dropped = 0;
+  SREG = sreg;
+
+}
@@ -0,0 +1,51 @@
+// MIDI thru: merges MIDI in with local output
+
+#ifndef MIDI_THRU_H
+#define MIDI_THRU_H
+
+/*
+ * Bytes received on pin 0 (PD0, RXD) are buffered by the USART receive
+ * interrupt:
+ * - Real-time bytes are forwarded from the interrupt right away, between any
+ *   two bytes of output (refer to midi_sched.h)
+ * - Everything else is parsed by midi_thru_service, with running status, into
+ *   whole messages queued in the scheduler's thru class, so forwarded and
+ *   local messages interleave only at message boundaries
+ * - System exclusive messages are not forwarded; each is counted
+ * - Building with LAYOUT_CHANNEL=<1 ~ 16>: program change and all notes off
+ *   received on that channel also act on the pad layout (refer to layout.h);
+ *   other channels are only forwarded
+ *
+ * Statistics, since the last reset:
+ * - Forwarded messages, real-time included
+ * - Dropped messages: thru queue or real-time slot full, receive buffer
+ *   overrun, framing errors, data bytes without status
+ * - System exclusive messages skipped
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Receive buffer capacity (power of 2); at 31250 baud one byte takes 320 us
+#define MIDI_THRU_RX_LEN 64U
+
+// --------------------------------------------------
+
+void midi_thru_init();
+
+void midi_thru_service();
+
+uint16_t midi_thru_stat_forwarded();
+
+uint16_t midi_thru_stat_dropped();
+
+uint16_t midi_thru_stat_sysex();
+
+void midi_thru_stat_reset();
+
+// --------------------------------------------------
+
+#endif
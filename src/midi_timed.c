@@ -0,0 +1,507 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "layout.h"
+#include "midi_sched.h"
+#include "midi_timed.h"
+#include "timer.h"
+
+#define STATUS_NOTE_OFF 0x80U
+#define STATUS_NOTE_ON 0x90U
+#define STATUS_CLOCK 0xf8U
+#define STATUS_REALTIME 0xf8U
+
+// Status value of a cancelled event
+#define STATUS_CANCELLED 0x00U
+
+// Pad values of events not tied to a pad
+#define PAD_NONE 0xffU
+#define PAD_CLOCK 0xfeU
+
+// Minimum lead when arming the compare match (timer ticks)
+#define LEAD_MIN 2U
+
+// Spacing of messages scheduled back to back (timer ticks)
+#define MSG_TICKS (3U * MIDI_TIMED_BYTE_TICKS + 4U)
+
+// Delay of note repeats after the clock grid, so that a clock due on about
+// the same tick is sent first (timer ticks)
+#define REPEAT_OFFSET (2U * MIDI_TIMED_BYTE_TICKS)
+
+// Heap slots the main loop leaves free, so that an event retried from the
+// interrupt always fits
+#define HEAP_RESERVE 1U
+
+// Clock intervals per minute, in timer ticks, times 256
+#define CLOCK_TICKS_PER_MIN_FP 160000000UL
+
+// --------------------------------------------------
+
+// Scheduled message
+struct midi_timed_event {
+  uint32_t due;
+  uint8_t pad;
+  uint8_t msg[3];
+};
+
+// Binary min-heap ordered by due time
+struct midi_timed_event midi_timed_heap[MIDI_TIMED_HEAP_LEN];
+uint8_t midi_timed_count;
+
+// Clock interval (timer ticks, 24.8 fixed point) and fraction of next clock
+uint32_t midi_timed_interval;
+uint8_t midi_timed_clock_frac;
+
+// Note repeat period (clock intervals, 0 if off) and next repeat time
+uint8_t midi_timed_repeat_clocks;
+uint32_t midi_timed_repeat_due;
+uint8_t midi_timed_repeat_frac;
+
+#ifdef MIDI_TIMED_JITTER
+uint16_t midi_timed_late_max;
+uint32_t midi_timed_late_sum;
+uint16_t midi_timed_sent;
+uint16_t midi_timed_missed;
+#endif
+
+// --------------------------------------------------
+
+// Heap operations; called with interrupts disabled
+
+uint8_t midi_timed_before(uint8_t a, uint8_t b) {
+
+  int32_t diff = (int32_t) (midi_timed_heap[a].due - midi_timed_heap[b].due);
+
+  // Same tick: real-time messages first
+  if(!diff) {
+    return midi_timed_heap[a].msg[0] >= STATUS_REALTIME
+    && midi_timed_heap[b].msg[0] < STATUS_REALTIME;
+  }
+
+  return diff < 0;
+
+}
+
+void midi_timed_swap(uint8_t a, uint8_t b) {
+
+  struct midi_timed_event event = midi_timed_heap[a];
+  midi_timed_heap[a] = midi_timed_heap[b];
+  midi_timed_heap[b] = event;
+
+}
+
+uint8_t midi_timed_push(struct midi_timed_event *event) {
+
+  if(midi_timed_count >= MIDI_TIMED_HEAP_LEN) {
+    return 1;
+  }
+
+  uint8_t i = midi_timed_count++;
+  midi_timed_heap[i] = *event;
+  while(i) {
+    uint8_t parent = (i - 1) / 2;
+    if(!midi_timed_before(i, parent)) {
+      break;
+    }
+    midi_timed_swap(i, parent);
+    i = parent;
+  }
+
+  return 0;
+
+}
+
+void midi_timed_pop() {
+
+  midi_timed_count--;
+  midi_timed_heap[0] = midi_timed_heap[midi_timed_count];
+
+  uint8_t i = 0;
+  while(1) {
+    uint8_t child = 2 * i + 1;
+    if(child >= midi_timed_count) {
+      break;
+    }
+    if(child + 1 < midi_timed_count && midi_timed_before(child + 1, child)) {
+      child++;
+    }
+    if(!midi_timed_before(child, i)) {
+      break;
+    }
+    midi_timed_swap(i, child);
+    i = child;
+  }
+
+}
+
+// --------------------------------------------------
+
+// Point the compare match at the earliest event; interrupts disabled
+void midi_timed_arm() {
+
+  if(!midi_timed_count) {
+    TIMSK1 &= ~(1 << OCIE1A);
+    return;
+  }
+
+  uint32_t now = timer_read_long();
+  if((int32_t) (midi_timed_heap[0].due - now) < (int32_t) LEAD_MIN) {
+    OCR1A = (uint16_t) now + LEAD_MIN;
+  } else {
+    OCR1A = (uint16_t) midi_timed_heap[0].due;
+  }
+  TIFR1 = (1 << OCF1A);
+  TIMSK1 |= (1 << OCIE1A);
+
+}
+
+// --------------------------------------------------
+
+// Advance a fixed point time by an interval
+uint32_t midi_timed_advance(uint32_t due, uint8_t *frac, uint32_t interval) {
+
+  uint16_t sum = *frac + (uint8_t) interval;
+  *frac = (uint8_t) sum;
+
+  return due + (interval >> 8) + (sum >> 8);
+
+}
+
+// --------------------------------------------------
+
+// Hand a due event to the output scheduler; interrupts disabled
+void midi_timed_emit(struct midi_timed_event *event) {
+
+  uint8_t result;
+  if(event->msg[0] >= STATUS_REALTIME) {
+    result = midi_sched_realtime(event->msg[0]);
+  } else {
+    result = midi_sched_inject(event->msg[0], event->msg[1], event->msg[2]);
+  }
+
+  // Slot for late output already taken: retry after one message, still
+  // tied to its pad so a release can cancel it; lost if the heap is full
+  if(result == MIDI_SCHED_BUSY) {
+    event->due += MSG_TICKS;
+    if(!midi_timed_push(event)) {
+      return;
+    }
+  }
+
+#ifdef MIDI_TIMED_JITTER
+  if(result == MIDI_SCHED_SENT) {
+    uint32_t late = timer_read_long() - event->due;
+    if(late > 0xffffU) {
+      late = 0xffffU;
+    }
+    if(late > midi_timed_late_max) {
+      midi_timed_late_max = late;
+    }
+    midi_timed_late_sum += late;
+    midi_timed_sent++;
+  } else {
+    midi_timed_missed++;
+  }
+#endif
+
+}
+
+// --------------------------------------------------
+
+ISR(TIMER1_COMPA_vect) {
+
+  while(midi_timed_count) {
+
+    if((int32_t) (midi_timed_heap[0].due - timer_read_long()) > 0) {
+      break;
+    }
+
+    struct midi_timed_event event = midi_timed_heap[0];
+    midi_timed_pop();
+    if(event.msg[0] == STATUS_CANCELLED) {
+      continue;
+    }
+
+    // Clock reschedules itself from its due time, not from now
+    if(event.pad == PAD_CLOCK) {
+      struct midi_timed_event next = event;
+      next.due = midi_timed_advance(event.due, &midi_timed_clock_frac,
+      midi_timed_interval);
+      midi_timed_push(&next);
+      event.pad = PAD_NONE;
+    }
+
+    midi_timed_emit(&event);
+
+  }
+
+  midi_timed_arm();
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_init() {
+
+  midi_timed_count = 0;
+  midi_timed_clock_frac = 0;
+  midi_timed_repeat_clocks = 0;
+  midi_timed_tempo(MIDI_TIMED_TEMPO_INIT);
+
+#ifdef MIDI_TIMED_JITTER
+  midi_timed_jitter_reset();
+#endif
+
+}
+
+// --------------------------------------------------
+
+uint8_t midi_timed_send(uint32_t due, uint8_t status, uint8_t data1,
+uint8_t data2) {
+
+  struct midi_timed_event event;
+  event.due = due;
+  event.pad = PAD_NONE;
+  event.msg[0] = status;
+  event.msg[1] = data1 & 0x7fU;
+  event.msg[2] = data2 & 0x7fU;
+
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t full = midi_timed_count + HEAP_RESERVE >= MIDI_TIMED_HEAP_LEN;
+  if(!full) {
+    midi_timed_push(&event);
+    midi_timed_arm();
+  }
+  SREG = sreg;
+
+  return full;
+
+}
+
+// --------------------------------------------------
+
+// Cancel every pending event tied to a pad; interrupts disabled
+void midi_timed_cancel_locked(uint8_t pad) {
+
+  for(uint8_t i = 0; i < midi_timed_count; i++) {
+    if(midi_timed_heap[i].pad == pad) {
+      midi_timed_heap[i].msg[0] = STATUS_CANCELLED;
+    }
+  }
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_cancel(uint8_t pad) {
+
+  uint8_t sreg = SREG;
+  cli();
+  midi_timed_cancel_locked(pad);
+  SREG = sreg;
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_tempo(uint8_t bpm) {
+
+  uint32_t interval = CLOCK_TICKS_PER_MIN_FP / (bpm ? bpm : 1);
+
+  // Takes effect from the next clock interval
+  uint8_t sreg = SREG;
+  cli();
+  midi_timed_interval = interval;
+  SREG = sreg;
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_clock_start() {
+
+  struct midi_timed_event event;
+  event.pad = PAD_CLOCK;
+  event.msg[0] = STATUS_CLOCK;
+  event.msg[1] = 0;
+  event.msg[2] = 0;
+
+  uint8_t sreg = SREG;
+  cli();
+  midi_timed_cancel_locked(PAD_CLOCK);
+  event.due = timer_read_long() + MIDI_TIMED_LOOKAHEAD;
+  midi_timed_clock_frac = 0;
+  // Keep note repeat on the new clock grid
+  midi_timed_repeat_due = event.due;
+  midi_timed_repeat_frac = 0;
+  midi_timed_push(&event);
+  midi_timed_arm();
+  SREG = sreg;
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_clock_stop() {
+
+  midi_timed_cancel(PAD_CLOCK);
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_repeat(uint8_t clocks) {
+
+  uint8_t sreg = SREG;
+  cli();
+
+  if(clocks && !midi_timed_repeat_clocks) {
+    // Align with the pending clock, if running
+    midi_timed_repeat_due = timer_read_long() + MIDI_TIMED_LOOKAHEAD;
+    midi_timed_repeat_frac = 0;
+    for(uint8_t i = 0; i < midi_timed_count; i++) {
+      if(midi_timed_heap[i].pad == PAD_CLOCK
+      && midi_timed_heap[i].msg[0] != STATUS_CANCELLED) {
+        midi_timed_repeat_due = midi_timed_heap[i].due;
+        midi_timed_repeat_frac = midi_timed_clock_frac;
+      }
+    }
+  }
+  midi_timed_repeat_clocks = clocks;
+
+  SREG = sreg;
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_service() {
+
+  if(!midi_timed_repeat_clocks) {
+    return;
+  }
+
+  uint32_t now = timer_read_long();
+  uint32_t period = midi_timed_interval * midi_timed_repeat_clocks;
+  if((int32_t) (midi_timed_repeat_due - now) > (int32_t) MIDI_TIMED_LOOKAHEAD) {
+    return;
+  }
+
+  // Schedule a note off and note on pair for every held pad whose press has
+  // gone out, back to back from the grid time; skipped if the loop stalled
+  // past it
+  if((int32_t) (midi_timed_repeat_due - now) > 0) {
+    struct midi_timed_event event;
+    event.due = midi_timed_repeat_due + REPEAT_OFFSET;
+    for(uint8_t pad = 0; pad < BUTTON_COUNT; pad++) {
+      uint8_t note = layout_held(pad);
+      if(note == LAYOUT_NOTE_NONE || midi_sched_pending(pad)) {
+        continue;
+      }
+      event.pad = pad;
+      event.msg[1] = note;
+      uint8_t sreg = SREG;
+      cli();
+      uint8_t full
+      = midi_timed_count + 2U + HEAP_RESERVE > MIDI_TIMED_HEAP_LEN;
+      if(!full) {
+        event.msg[0] = STATUS_NOTE_OFF;
+        event.msg[2] = 0;
+        midi_timed_push(&event);
+        event.due += MSG_TICKS;
+        event.msg[0] = STATUS_NOTE_ON;
+        event.msg[2] = 127;
+        midi_timed_push(&event);
+        event.due += MSG_TICKS;
+      }
+      SREG = sreg;
+      if(full) {
+        break;
+      }
+    }
+
+    uint8_t sreg = SREG;
+    cli();
+    midi_timed_arm();
+    SREG = sreg;
+  }
+
+  midi_timed_repeat_due = midi_timed_advance(midi_timed_repeat_due,
+  &midi_timed_repeat_frac, period);
+
+}
+
+// --------------------------------------------------
+
+uint8_t midi_timed_holdoff(uint8_t bytes, uint8_t starting) {
+
+  if(!midi_timed_count || midi_timed_heap[0].msg[0] == STATUS_CANCELLED) {
+    return 0;
+  }
+
+  // A real-time byte needs the data and shift registers empty; anything else
+  // needs a message boundary
+  uint16_t need;
+  if(midi_timed_heap[0].msg[0] >= STATUS_REALTIME) {
+    need = 2 * MIDI_TIMED_BYTE_TICKS;
+  } else if(starting) {
+    need = (bytes + 1) * MIDI_TIMED_BYTE_TICKS;
+  } else {
+    return 0;
+  }
+
+  return (int32_t) (midi_timed_heap[0].due - timer_read_long())
+  < (int32_t) need;
+
+}
+
+// --------------------------------------------------
+
+#ifdef MIDI_TIMED_JITTER
+
+uint16_t midi_timed_jitter_max() {
+
+  return midi_timed_late_max;
+
+}
+
+// --------------------------------------------------
+
+uint32_t midi_timed_jitter_sum() {
+
+  return midi_timed_late_sum;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_timed_jitter_count() {
+
+  return midi_timed_sent;
+
+}
+
+// --------------------------------------------------
+
+uint16_t midi_timed_jitter_late() {
+
+  return midi_timed_missed;
+
+}
+
+// --------------------------------------------------
+
+void midi_timed_jitter_reset() {
+
+  uint8_t sreg = SREG;
+  cli();
+  midi_timed_late_max = 0;
+  midi_timed_late_sum = 0;
+  midi_timed_sent = 0;
+  midi_timed_missed = 0;
+  SREG = sreg;
+
+}
+
+#endif
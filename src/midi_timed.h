@@ -0,0 +1,88 @@
+// Timer-driven MIDI event scheduler
+
+#ifndef MIDI_TIMED_H
+#define MIDI_TIMED_H
+
+/*
+ * Min-heap of timestamped messages, sent from the Timer1 compare match A
+ * interrupt when due (time base in timer.h); requires global interrupts
+ * - Real-time messages go straight to the USART; the output scheduler
+ *   (midi_sched.h) keeps the line idle ahead of them, so they start within
+ *   interrupt latency of their due time
+ * - Other messages start when due if the line is at a message boundary,
+ *   otherwise at the next boundary ahead of all queued messages
+ *
+ * Built-in generators:
+ * - MIDI clock (0xF8), 24 per quarter note at the set tempo; drift-free,
+ *   intervals kept in fixed point
+ * - Note repeat: held notes (read from layout.h) are retriggered with a
+ *   note off and note on pair every given number of clock intervals, two
+ *   byte times after the clock grid; scheduled from the main loop
+ *   MIDI_TIMED_LOOKAHEAD ticks ahead, only once the pad's own note on has
+ *   been sent, and cancelled per pad on release
+ * - Events due on the same tick go out real-time first; one heap slot is
+ *   kept free for events retried from the interrupt
+ *
+ * Build options (OPTS):
+ * - -DMIDI_CLOCK_BPM=<bpm>: start the clock at boot
+ * - -DMIDI_REPEAT_CLOCKS=<clocks>: enable note repeat at boot
+ * - -DMIDI_TIMED_JITTER: measure lateness of each timed event, from due time
+ *   to its first byte entering the USART, and count events that missed
+ *   their slot
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Capacity of the event heap
+#define MIDI_TIMED_HEAP_LEN 16U
+
+// Transmit time of one byte at 31250 baud (timer ticks)
+#define MIDI_TIMED_BYTE_TICKS 80U
+
+// How far ahead note repeats are scheduled (timer ticks)
+#define MIDI_TIMED_LOOKAHEAD 2500U
+
+// Tempo at boot (BPM)
+#define MIDI_TIMED_TEMPO_INIT 120U
+
+// --------------------------------------------------
+
+void midi_timed_init();
+
+uint8_t midi_timed_send(uint32_t, uint8_t, uint8_t, uint8_t);
+
+void midi_timed_cancel(uint8_t);
+
+void midi_timed_tempo(uint8_t);
+
+void midi_timed_clock_start();
+
+void midi_timed_clock_stop();
+
+void midi_timed_repeat(uint8_t);
+
+void midi_timed_service();
+
+uint8_t midi_timed_holdoff(uint8_t, uint8_t);
+
+#ifdef MIDI_TIMED_JITTER
+
+uint16_t midi_timed_jitter_max();
+
+uint32_t midi_timed_jitter_sum();
+
+uint16_t midi_timed_jitter_count();
+
+uint16_t midi_timed_jitter_late();
+
+void midi_timed_jitter_reset();
+
+#endif
+
+// --------------------------------------------------
+
+#endif
@@ -0,0 +1,251 @@
+#include "common.h"
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include <avr/wdt.h>
+#include "debounce.h"
+#include "input.h"
+#include "midi_sched.h"
+#include "midi_thru.h"
+#include "scan_rate.h"
+#include "midi_timed.h"
+#include "scan_watch.h"
+#include "serial_print.h"
+#include "timer.h"
+
+// --------------------------------------------------
+
+// Phase start times (timer ticks)
+uint16_t profile_start[PROFILE_PHASE_COUNT];
+
+// Phase statistics since last dump (timer ticks)
+uint16_t profile_min[PROFILE_PHASE_COUNT];
+uint16_t profile_max[PROFILE_PHASE_COUNT];
+uint32_t profile_sum[PROFILE_PHASE_COUNT];
+uint16_t profile_count[PROFILE_PHASE_COUNT];
+
+// Loop iterations since last dump
+uint16_t profile_loops;
+
+// Phase labels
+char *profile_names[PROFILE_PHASE_COUNT] = {
+  "read", "debounce", "midi", "lcd", "scan"
+};
+
+// MIDI output class labels
+char *profile_class_names[MIDI_SCHED_CLASS_COUNT] = {
+  "on", "off", "status", "thru", "cc"
+};
+
+// --------------------------------------------------
+
+// Scan supervision record, kept across resets
+void profile_print_watch() {
+
+  serial_print_string("watch scans ");
+  serial_print_number(scan_watch_scans());
+  serial_print_string(" overruns ");
+  serial_print_number(scan_watch_overruns());
+  serial_print_string(" worst us ");
+  serial_print_number((uint32_t) scan_watch_worst() * TIMER_US_PER_TICK);
+  serial_print_string(" wedges ");
+  serial_print_number(scan_watch_wedges());
+  serial_print_string(" resets ");
+  serial_print_number(scan_watch_resets());
+  serial_print_newline();
+
+}
+
+// --------------------------------------------------
+
+void profile_boot(uint32_t ticks, uint8_t ready) {
+
+  midi_sched_flush();
+
+  serial_print_string("boot us ");
+  serial_print_number(ticks * TIMER_US_PER_TICK);
+  serial_print_string(" expanders ");
+  serial_print_binary(ready);
+  serial_print_newline();
+  profile_print_watch();
+
+}
+
+// --------------------------------------------------
+
+void profile_begin(uint8_t phase) {
+
+  profile_start[phase] = timer_read();
+
+}
+
+// --------------------------------------------------
+
+void profile_end(uint8_t phase) {
+
+  uint16_t ticks = timer_read() - profile_start[phase];
+
+  if(!profile_count[phase] || ticks < profile_min[phase]) {
+    profile_min[phase] = ticks;
+  }
+  if(ticks > profile_max[phase]) {
+    profile_max[phase] = ticks;
+  }
+  profile_sum[phase] += ticks;
+  profile_count[phase]++;
+
+}
+
+// --------------------------------------------------
+
+void profile_loop() {
+
+  profile_loops++;
+  if(profile_loops < PROFILE_DUMP_PERIOD) {
+    return;
+  }
+  profile_loops = 0;
+
+  // Let queued MIDI out first so text does not split a message
+  midi_sched_flush();
+
+  for(uint8_t phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+    serial_print_string(profile_names[phase]);
+    if(profile_count[phase]) {
+      serial_print_string(" min ");
+      serial_print_number((uint32_t) profile_min[phase]
+      * TIMER_CYCLES_PER_TICK);
+      serial_print_string(" max ");
+      serial_print_number((uint32_t) profile_max[phase]
+      * TIMER_CYCLES_PER_TICK);
+      serial_print_string(" mean ");
+      serial_print_number(profile_sum[phase] * TIMER_CYCLES_PER_TICK
+      / profile_count[phase]);
+      serial_print_string(" n ");
+      serial_print_number(profile_count[phase]);
+    } else {
+      serial_print_string(" -");
+    }
+    serial_print_newline();
+    // Printing is slow at MIDI baud rates; keep the watchdog fed
+    wdt_reset();
+
+    profile_min[phase] = 0;
+    profile_max[phase] = 0;
+    profile_sum[phase] = 0;
+    profile_count[phase] = 0;
+  }
+
+  // Debounce statistics since the previous dump
+  serial_print_string("debounce acks ");
+  serial_print_number(debounce_stat_acks());
+  serial_print_string(" reverts ");
+  serial_print_number(debounce_stat_reverts());
+  serial_print_string(" delay ");
+  serial_print_number(debounce_stat_delay());
+  serial_print_newline();
+  debounce_stat_reset();
+
+#if DEBOUNCE_MODE == DEBOUNCE_MODE_ADAPTIVE
+  // Buttons that chattered or widened their window since boot: window and
+  // worst bounce (ms), chatter count; points at failing switches
+  for(uint8_t button = 0; button < BUTTON_COUNT; button++) {
+    if(!debounce_chatter(button)
+    && debounce_window(button) <= DEBOUNCE_WINDOW_INIT) {
+      continue;
+    }
+    serial_print_string("button ");
+    serial_print_number(button);
+    serial_print_string(" window ");
+    serial_print_number(debounce_window(button));
+    serial_print_string(" bounce ");
+    serial_print_number(debounce_bounce_max(button));
+    serial_print_string(" chatter ");
+    serial_print_number(debounce_chatter(button));
+    serial_print_newline();
+    wdt_reset();
+  }
+#endif
+
+  // Time and bus reads per scan rate level since the previous dump
+  for(uint8_t level = 0; level < SCAN_RATE_LEVELS; level++) {
+    serial_print_string("rate ");
+    serial_print_number(level);
+    serial_print_string(" ms ");
+    serial_print_number(scan_rate_stat_time(level));
+    serial_print_string(" reads ");
+    serial_print_number(scan_rate_stat_reads(level));
+    serial_print_newline();
+  }
+  scan_rate_stat_reset();
+  wdt_reset();
+
+  // MIDI output since the previous dump: link utilisation (per mille),
+  // controller values coalesced and dropped
+  serial_print_string("link util ");
+  serial_print_number(midi_sched_stat_util());
+  serial_print_string(" cc coalesced ");
+  serial_print_number(midi_sched_stat_coalesced());
+  serial_print_string(" dropped ");
+  serial_print_number(midi_sched_stat_dropped());
+  serial_print_newline();
+  midi_sched_stat_reset();
+
+  // Worst time from queueing to transmission per output class since the
+  // previous dump, in microseconds
+  serial_print_string("queue us");
+  for(uint8_t class = 0; class < MIDI_SCHED_CLASS_COUNT; class++) {
+    serial_print_string(" ");
+    serial_print_string(profile_class_names[class]);
+    serial_print_string(" ");
+    serial_print_number((uint32_t) midi_sched_delay_max(class)
+    * TIMER_US_PER_TICK);
+  }
+  serial_print_newline();
+  midi_sched_delay_reset();
+
+  // MIDI thru statistics since the previous dump
+  serial_print_string("thru fwd ");
+  serial_print_number(midi_thru_stat_forwarded());
+  serial_print_string(" drop ");
+  serial_print_number(midi_thru_stat_dropped());
+  serial_print_string(" sysex ");
+  serial_print_number(midi_thru_stat_sysex());
+  serial_print_newline();
+  midi_thru_stat_reset();
+
+  profile_print_watch();
+  wdt_reset();
+
+#if INPUT_BACKEND == INPUT_BACKEND_MATRIX
+  // Possible ghost rectangles formed since boot
+  serial_print_string("matrix ghosts ");
+  serial_print_number(input_matrix_ghosts());
+  serial_print_newline();
+#endif
+
+#ifdef MIDI_TIMED_JITTER
+  // Timed event lateness since the previous dump, in microseconds
+  serial_print_string("timed max ");
+  serial_print_number((uint32_t) midi_timed_jitter_max() * TIMER_US_PER_TICK);
+  serial_print_string(" mean ");
+  if(midi_timed_jitter_count()) {
+    serial_print_number(midi_timed_jitter_sum() * TIMER_US_PER_TICK
+    / midi_timed_jitter_count());
+  } else {
+    serial_print_string("-");
+  }
+  serial_print_string(" n ");
+  serial_print_number(midi_timed_jitter_count());
+  serial_print_string(" late ");
+  serial_print_number(midi_timed_jitter_late());
+  serial_print_newline();
+  midi_timed_jitter_reset();
+#endif
+
+}
+
+// --------------------------------------------------
+
+#endif
@@ -0,0 +1,78 @@
+// Per-phase profiler for the main loop
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*
+ * Opt-in; enabled by building with "make compile OPTS=-DPROFILE"
+ * - Without PROFILE, the macros below expand to nothing and the module
+ *   compiles to no code or data
+ * - Phases are bracketed with reads of Timer1 (refer to timer.h), so
+ *   resolution is TIMER_CYCLES_PER_TICK cycles and a phase must be shorter
+ *   than one timer period
+ * - Boot time, the I/O expanders found and the scan supervision record
+ *   (refer to scan_watch.h) are printed once at boot
+ * - The scan is pipelined (refer to input.h), so "read" and "debounce" are
+ *   sampled once per input group: "read" is the time spent waiting for a
+ *   group's transfer after the previous group was debounced, and "scan" the
+ *   whole pipelined read and debounce; with full overlap, "scan" approaches
+ *   the larger of the bus and debounce times instead of their sum
+ * - Every PROFILE_DUMP_PERIOD loop iterations, min/max/mean cycles per phase
+ *   are printed as text over the USART and the statistics restart; read them
+ *   with the usbserial 16U2 firmware and a terminal
+ * - Debounce, scan rate, MIDI output and MIDI thru statistics (refer to
+ *   debounce.h, scan_rate.h, midi_sched.h, midi_thru.h) and, if built with
+ *   MIDI_TIMED_JITTER, timed event jitter (refer to midi_timed.h) are printed
+ *   and reset along with the phases; the scan supervision record is printed
+ *   but kept
+ * - In adaptive debounce mode, every button that has chattered or widened
+ *   its window since boot is listed with its window, worst bounce and
+ *   chatter count
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Main loop phases
+#define PROFILE_PHASE_READ 0U
+#define PROFILE_PHASE_DEBOUNCE 1U
+#define PROFILE_PHASE_MIDI 2U
+#define PROFILE_PHASE_LCD 3U
+#define PROFILE_PHASE_SCAN 4U
+#define PROFILE_PHASE_COUNT 5U
+
+// Loop iterations between dumps
+#define PROFILE_DUMP_PERIOD 1000U
+
+#ifdef PROFILE
+#define PROFILE_BOOT(ticks, ready) profile_boot(ticks, ready)
+#define PROFILE_BEGIN(phase) profile_begin(phase)
+#define PROFILE_END(phase) profile_end(phase)
+#define PROFILE_LOOP() profile_loop()
+#else
+#define PROFILE_BOOT(ticks, ready)
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#define PROFILE_LOOP()
+#endif
+
+// --------------------------------------------------
+
+#ifdef PROFILE
+
+void profile_boot(uint32_t, uint8_t);
+
+void profile_begin(uint8_t);
+
+void profile_end(uint8_t);
+
+void profile_loop();
+
+#endif
+
+// --------------------------------------------------
+
+#endif
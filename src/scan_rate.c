@@ -0,0 +1,128 @@
+#include "common.h"
+#include "midi_sched.h"
+#include "midi_thru.h"
+#include "scan_rate.h"
+#include "timer.h"
+
+// --------------------------------------------------
+
+// Minimum time from one scan's start to the next, per level (timer ticks)
+const uint16_t scan_rate_period[SCAN_RATE_LEVELS] = {
+  0, 500, 1000, 2000
+};
+
+// Current level, start of the current scan, last activity (timer ticks)
+uint8_t scan_rate_lvl;
+uint32_t scan_rate_start;
+uint32_t scan_rate_active;
+
+// Timer ticks not yet handed out as whole milliseconds
+uint16_t scan_rate_carry;
+
+// Statistics per level: time (timer ticks), scans that read the bus
+uint32_t scan_rate_ticks[SCAN_RATE_LEVELS];
+uint32_t scan_rate_reads[SCAN_RATE_LEVELS];
+
+// --------------------------------------------------
+
+void scan_rate_init() {
+
+  scan_rate_lvl = 0;
+  scan_rate_start = timer_read_long();
+  scan_rate_active = scan_rate_start;
+  scan_rate_carry = 0;
+  scan_rate_stat_reset();
+
+}
+
+// --------------------------------------------------
+
+// Wait for the current level's scan period; return elapsed time (ms)
+uint8_t scan_rate_begin() {
+
+  uint16_t period = scan_rate_period[scan_rate_lvl];
+  uint32_t now = timer_read_long();
+
+  while(now - scan_rate_start < period) {
+    midi_thru_service();
+    midi_sched_service();
+    now = timer_read_long();
+  }
+
+  uint32_t ticks = now - scan_rate_start;
+  scan_rate_start = now;
+  scan_rate_ticks[scan_rate_lvl] += ticks;
+
+  // Whole milliseconds, saturating
+  if(ticks > 0xff * SCAN_RATE_TICKS_PER_MS) {
+    scan_rate_carry = 0;
+    return 0xffU;
+  }
+  scan_rate_carry += (uint16_t) ticks;
+  uint8_t elapsed = scan_rate_carry / SCAN_RATE_TICKS_PER_MS;
+  scan_rate_carry -= elapsed * SCAN_RATE_TICKS_PER_MS;
+
+  return elapsed;
+
+}
+
+// --------------------------------------------------
+
+// Pick the next scan's level, given whether this scan saw a pending edge and
+// whether it read the input bus
+void scan_rate_end(uint8_t active, uint8_t read) {
+
+  if(read) {
+    scan_rate_reads[scan_rate_lvl]++;
+  }
+
+  if(active) {
+    scan_rate_active = scan_rate_start;
+    scan_rate_lvl = 0;
+    return;
+  }
+
+  uint32_t idle = scan_rate_start - scan_rate_active;
+  uint8_t level = 0;
+  while(level < SCAN_RATE_LEVELS - 1 && idle >= SCAN_RATE_HOLD) {
+    idle -= SCAN_RATE_HOLD;
+    level++;
+  }
+  scan_rate_lvl = level;
+
+}
+
+// --------------------------------------------------
+
+uint8_t scan_rate_level() {
+
+  return scan_rate_lvl;
+
+}
+
+// --------------------------------------------------
+
+uint32_t scan_rate_stat_time(uint8_t level) {
+
+  return scan_rate_ticks[level] / SCAN_RATE_TICKS_PER_MS;
+
+}
+
+// --------------------------------------------------
+
+uint32_t scan_rate_stat_reads(uint8_t level) {
+
+  return scan_rate_reads[level];
+
+}
+
+// --------------------------------------------------
+
+void scan_rate_stat_reset() {
+
+  for(uint8_t level = 0; level < SCAN_RATE_LEVELS; level++) {
+    scan_rate_ticks[level] = 0;
+    scan_rate_reads[level] = 0;
+  }
+
+}
@@ -0,0 +1,59 @@
+// Scan-rate governor
+
+#ifndef SCAN_RATE_H
+#define SCAN_RATE_H
+
+/*
+ * Paces the main loop by activity
+ * - Level 0 scans back to back, as fast as the input bus allows; levels 1 ~ 3
+ *   start a scan at most every 2, 4 and 8 ms
+ * - Any button whose live state differs from its acknowledged state (an edge
+ *   being debounced) returns to level 0; after SCAN_RATE_HOLD without one,
+ *   each further SCAN_RATE_HOLD drops one level
+ * - While waiting for the next scan, queued MIDI output and MIDI thru input
+ *   are serviced; the wait is outside the supervised scan (refer to
+ *   scan_watch.h)
+ * - scan_rate_begin returns the time since the previous scan in
+ *   milliseconds, carrying fractions over, for debounce_tick (refer to
+ *   debounce.h)
+ *
+ * Statistics per level, since the last reset:
+ * - Time spent (ms)
+ * - Scans that read the input bus; divided by the time, the bus load in
+ *   reads per second
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Number of rate levels
+#define SCAN_RATE_LEVELS 4U
+
+// Time at one level before stepping down (timer ticks, 300 ms)
+#define SCAN_RATE_HOLD 75000UL
+
+// Timer ticks per millisecond
+#define SCAN_RATE_TICKS_PER_MS 250U
+
+// --------------------------------------------------
+
+void scan_rate_init();
+
+uint8_t scan_rate_begin();
+
+void scan_rate_end(uint8_t, uint8_t);
+
+uint8_t scan_rate_level();
+
+uint32_t scan_rate_stat_time(uint8_t);
+
+uint32_t scan_rate_stat_reads(uint8_t);
+
+void scan_rate_stat_reset();
+
+// --------------------------------------------------
+
+#endif
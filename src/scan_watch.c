@@ -0,0 +1,149 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include "scan_watch.h"
+#include "timer.h"
+
+// Marks the record in .noinit RAM as valid
+#define RECORD_MAGIC 0x5a17U
+
+// --------------------------------------------------
+
+// Supervision record, kept across resets
+struct scan_watch_record {
+  uint16_t magic;
+  uint32_t scans;
+  uint16_t overruns;
+  uint16_t worst;
+  uint16_t wedges;
+  uint16_t resets;
+};
+
+struct scan_watch_record scan_watch_rec __attribute__((section(".noinit")));
+
+// Reset cause, saved before the C runtime starts
+uint8_t scan_watch_mcusr __attribute__((section(".noinit")));
+
+// Start time of the current scan (timer ticks)
+volatile uint16_t scan_watch_start;
+
+// --------------------------------------------------
+
+// A watchdog reset leaves the watchdog running at its shortest timeout, so
+// it has to be stopped before the C runtime and main() get going
+void scan_watch_early() __attribute__((naked, used, section(".init3")));
+
+void scan_watch_early() {
+
+  scan_watch_mcusr = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+
+}
+
+// --------------------------------------------------
+
+ISR(WDT_vect) {
+
+  // Loop has stalled; record it, the next timeout resets the controller
+  scan_watch_rec.wedges++;
+  uint16_t ticks = timer_read() - scan_watch_start;
+  if(ticks > scan_watch_rec.worst) {
+    scan_watch_rec.worst = ticks;
+  }
+
+}
+
+// --------------------------------------------------
+
+void scan_watch_init() {
+
+  // Start over on power-on or brown-out, or if the record is not intact
+  if((scan_watch_mcusr & ((1 << PORF) | (1 << BORF)))
+  || scan_watch_rec.magic != RECORD_MAGIC) {
+    scan_watch_rec.magic = RECORD_MAGIC;
+    scan_watch_rec.scans = 0;
+    scan_watch_rec.overruns = 0;
+    scan_watch_rec.worst = 0;
+    scan_watch_rec.wedges = 0;
+    scan_watch_rec.resets = 0;
+  }
+  if(scan_watch_mcusr & (1 << WDRF)) {
+    scan_watch_rec.resets++;
+  }
+
+  scan_watch_start = timer_read();
+
+  wdt_enable(SCAN_WATCH_TIMEOUT);
+  WDTCSR |= (1 << WDIE);
+
+}
+
+// --------------------------------------------------
+
+void scan_watch_begin() {
+
+  scan_watch_start = timer_read();
+
+}
+
+// --------------------------------------------------
+
+void scan_watch_end() {
+
+  uint16_t ticks = timer_read() - scan_watch_start;
+
+  scan_watch_rec.scans++;
+  if(ticks > scan_watch_rec.worst) {
+    scan_watch_rec.worst = ticks;
+  }
+  if(ticks > SCAN_WATCH_DEADLINE && scan_watch_rec.overruns < 0xffffU) {
+    scan_watch_rec.overruns++;
+  }
+
+  // Kick the watchdog; re-arm its interrupt in case a stall used it up
+  wdt_reset();
+  WDTCSR |= (1 << WDIE);
+
+}
+
+// --------------------------------------------------
+
+uint32_t scan_watch_scans() {
+
+  return scan_watch_rec.scans;
+
+}
+
+// --------------------------------------------------
+
+uint16_t scan_watch_overruns() {
+
+  return scan_watch_rec.overruns;
+
+}
+
+// --------------------------------------------------
+
+uint16_t scan_watch_worst() {
+
+  return scan_watch_rec.worst;
+
+}
+
+// --------------------------------------------------
+
+uint16_t scan_watch_wedges() {
+
+  return scan_watch_rec.wedges;
+
+}
+
+// --------------------------------------------------
+
+uint16_t scan_watch_resets() {
+
+  return scan_watch_rec.resets;
+
+}
@@ -0,0 +1,51 @@
+// Scan deadline monitor and watchdog supervisor
+
+#ifndef SCAN_WATCH_H
+#define SCAN_WATCH_H
+
+/*
+ * - Each main loop scan is timed against SCAN_WATCH_DEADLINE; a scan that
+ *   takes longer fails and is counted as an overrun, along with how far the
+ *   worst one went over
+ * - The watchdog runs in interrupt + reset mode and is kicked once per
+ *   completed scan; a wedged loop first records the stall in the watchdog
+ *   interrupt, then resets the controller on the next timeout
+ * - Counters live in .noinit RAM, so they survive watchdog and external
+ *   resets and are only cleared on power-on or brown-out
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Maximum duration of one scan (timer ticks, 5 ms)
+#ifndef SCAN_WATCH_DEADLINE
+#define SCAN_WATCH_DEADLINE 1250U
+#endif
+
+// Watchdog timeout (avr/wdt.h constant)
+#define SCAN_WATCH_TIMEOUT WDTO_250MS
+
+// --------------------------------------------------
+
+void scan_watch_init();
+
+void scan_watch_begin();
+
+void scan_watch_end();
+
+uint32_t scan_watch_scans();
+
+uint16_t scan_watch_overruns();
+
+uint16_t scan_watch_worst();
+
+uint16_t scan_watch_wedges();
+
+uint16_t scan_watch_resets();
+
+// --------------------------------------------------
+
+#endif
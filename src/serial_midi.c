@@ -38,3 +38,44 @@ void serial_midi_note_on(uint8_t note, uint8_t velocity) {
   UDR0 = (uint8_t) (velocity);
 
 }
+
+// --------------------------------------------------
+
+uint8_t serial_midi_tx_ready() {
+
+  return (UCSR0A & (1 << UDRE0)) ? 1 : 0;
+
+}
+
+// --------------------------------------------------
+
+void serial_midi_tx_byte(uint8_t data) {
+
+  UDR0 = data;
+
+}
+
+// --------------------------------------------------
+
+uint8_t serial_midi_msg_len(uint8_t status) {
+
+  // Program change, channel pressure
+  if((status & 0xe0U) == 0xc0U) {
+    return 2;
+  }
+  // Other channel messages
+  if(status < 0xf0U) {
+    return 3;
+  }
+  // Time code quarter frame, song select
+  if(status == 0xf1U || status == 0xf3U) {
+    return 2;
+  }
+  // Song position pointer
+  if(status == 0xf2U) {
+    return 3;
+  }
+  // Tune request, real-time
+  return 1;
+
+}
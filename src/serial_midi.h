@@ -11,6 +11,12 @@ void serial_midi_note_off(uint8_t);
 
 void serial_midi_note_on(uint8_t, uint8_t);
 
+uint8_t serial_midi_tx_ready();
+
+void serial_midi_tx_byte(uint8_t);
+
+uint8_t serial_midi_msg_len(uint8_t);
+
 // --------------------------------------------------
 
 #endif
@@ -0,0 +1,29 @@
+#include "common.h"
+#include <avr/io.h>
+#include "spi.h"
+
+// --------------------------------------------------
+
+void spi_init() {
+
+  // SS high (deselected) before it becomes an output
+  PORTB |= (1 << PORTB2);
+  DDRB |= (1 << DDB2) | (1 << DDB3) | (1 << DDB5);
+  DDRB &= ~(1 << DDB4);
+
+  // Enable, master, mode 0, clock / 2
+  SPCR = (1 << SPE) | (1 << MSTR);
+  SPSR = (1 << SPI2X);
+
+}
+
+// --------------------------------------------------
+
+uint8_t spi_transfer(uint8_t data) {
+
+  SPDR = data;
+  while(!(SPSR & (1 << SPIF)));
+
+  return SPDR;
+
+}
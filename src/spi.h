@@ -0,0 +1,26 @@
+// Serial peripheral interface (SPI), master mode
+
+#ifndef SPI_H
+#define SPI_H
+
+/*
+ * Mode 0, MSB first, clock / 2 (8 MHz)
+ * - SCK: pin 13 (PB5)
+ * - MISO: pin 12 (PB4)
+ * - MOSI: pin 11 (PB3)
+ * - SS: pin 10 (PB2), driven by the caller as chip select
+ * Shares pins with the text LCD (refer to text_lcd.h); the two cannot be
+ * used together.
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+void spi_init();
+
+uint8_t spi_transfer(uint8_t);
+
+// --------------------------------------------------
+
+#endif
@@ -2,6 +2,7 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include "text_lcd.h"
+#include "timer.h"
 
 // Delay after each instruction
 #define DELAY_BUSY 5
@@ -19,9 +20,22 @@ uint8_t rgb_trans_on;
 volatile uint8_t rgb_incr_color;
 volatile uint8_t rgb_incr_color_val;
 
+// Time of the last non-blocking write and how long it takes (timer ticks)
+uint16_t text_lcd_post_time;
+uint16_t text_lcd_post_wait;
+
+// Next write of the non-blocking initialization
+uint8_t text_lcd_init_step;
+
+// Instructions sent by the non-blocking initialization, after the switch to
+// 4-bit operation: function set, display control, entry mode set (as in
+// text_lcd_init), then clear display
+const uint8_t text_lcd_init_instr[] = {0x28, 0x0c, 0x06, 0x01};
+
 // --------------------------------------------------
 
-void text_lcd_init() {
+// Set up variables and pins without writing to the controller
+void text_lcd_init_post() {
 
   // Initialize variables
   pwm_rgb_red = 0;
@@ -30,6 +44,9 @@ void text_lcd_init() {
   rgb_trans_on = 0;
   rgb_incr_color = 0;
   rgb_incr_color_val = PWM_MAX;
+  text_lcd_post_time = timer_read();
+  text_lcd_post_wait = 0;
+  text_lcd_init_step = 0;
 
   // ----------------------------------------
 
@@ -52,7 +69,13 @@ void text_lcd_init() {
   // Set pin 3 to output mode
   DDRD |= (1 << DDD3);
 
-  // ----------------------------------------
+}
+
+// --------------------------------------------------
+
+void text_lcd_init() {
+
+  text_lcd_init_post();
 
   // Function set: 4-bit operation
   PORTB |= (1 << PORTB3);
@@ -393,3 +416,129 @@ void text_lcd_backlight_rgb_trans_off() {
   rgb_trans_on = 0;
 
 }
+
+// --------------------------------------------------
+
+// Put a nibble on d7 ~ d4 and latch it, without waiting
+void text_lcd_strobe(uint8_t data_mode, uint8_t nibble) {
+
+  // Enable: rising edge
+  PORTB |= (1 << PORTB3);
+
+  // Register select: data or instruction
+  if(data_mode) {
+    PORTB |= (1 << PORTB4);
+  } else {
+    PORTB &= ~(1 << PORTB4);
+  }
+  // d7
+  if(0x08 & nibble) {
+    PORTD |= (1 << PORTD7);
+  } else {
+    PORTD &= ~(1 << PORTD7);
+  }
+  // d6
+  if(0x04 & nibble) {
+    PORTB |= (1 << PORTB0);
+  } else {
+    PORTB &= ~(1 << PORTB0);
+  }
+  // d5
+  if(0x02 & nibble) {
+    PORTB |= (1 << PORTB1);
+  } else {
+    PORTB &= ~(1 << PORTB1);
+  }
+  // d4
+  if(0x01 & nibble) {
+    PORTB |= (1 << PORTB2);
+  } else {
+    PORTB &= ~(1 << PORTB2);
+  }
+
+  // Enable: falling edge
+  PORTB &= ~(1 << PORTB3);
+
+}
+
+// --------------------------------------------------
+
+// Reset registers after a write and start timing its execution
+void text_lcd_post_end(uint16_t wait) {
+
+  // Reset registers
+  PORTB &= ~(1 << PORTB4);
+  PORTD &= ~(1 << PORTD7);
+  PORTB &= ~(1 << PORTB0);
+  PORTB &= ~(1 << PORTB1);
+  PORTB &= ~(1 << PORTB2);
+
+  text_lcd_post_time = timer_read();
+  text_lcd_post_wait = wait;
+
+}
+
+// --------------------------------------------------
+
+// Send both nibbles of a byte, without waiting for it to execute
+void text_lcd_post(uint8_t data_mode, uint8_t code) {
+
+  text_lcd_strobe(data_mode, code >> 4);
+  text_lcd_strobe(data_mode, code & 0x0f);
+  text_lcd_post_end(TEXT_LCD_EXEC_TICKS);
+
+}
+
+// --------------------------------------------------
+
+uint8_t text_lcd_post_init() {
+
+  uint8_t count = sizeof(text_lcd_init_instr);
+
+  if(text_lcd_init_step > count) {
+    return 1;
+  }
+
+  // Function set: 4-bit operation; a single nibble, still read as 8-bit
+  if(!text_lcd_init_step) {
+    text_lcd_strobe(0, 0x02);
+    text_lcd_post_end(TEXT_LCD_EXEC_TICKS);
+  } else {
+    text_lcd_post(0, text_lcd_init_instr[text_lcd_init_step - 1]);
+  }
+  text_lcd_init_step++;
+
+  // Clear display, sent last, takes longer
+  if(text_lcd_init_step > count) {
+    text_lcd_post_wait = TEXT_LCD_CLEAR_TICKS;
+    return 1;
+  }
+
+  return 0;
+
+}
+
+// --------------------------------------------------
+
+uint8_t text_lcd_post_ready() {
+
+  return (uint16_t) (timer_read() - text_lcd_post_time)
+  >= text_lcd_post_wait;
+
+}
+
+// --------------------------------------------------
+
+void text_lcd_post_instr(uint8_t code) {
+
+  text_lcd_post(0, code);
+
+}
+
+// --------------------------------------------------
+
+void text_lcd_post_char(uint8_t code) {
+
+  text_lcd_post(1, code);
+
+}
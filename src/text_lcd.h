@@ -14,12 +14,42 @@
  * - Backlight RGB red: pin 6 (PD6)
  * - Backlight RGB green: pin 5 (PD5)
  * - Backlight RGB blue: pin 3 (PD3)
+ *
+ * Blocking calls wait a fixed DELAY_BUSY after every nibble. The text_lcd_post
+ * calls instead send an instruction or data byte at once and return; the
+ * controller then needs TEXT_LCD_EXEC_TICKS before the next one, which
+ * text_lcd_post_ready reports (the read/write line is tied low, so the busy
+ * flag cannot be read). Custom characters 0 ~ 7 are defined in CGRAM, 8 rows
+ * of 5 pixels each, low 5 bits of each row byte, top row first.
+ *
+ * Without blocking at all: text_lcd_init_post sets up pins only, then, once
+ * TEXT_LCD_POWER_UP_TICKS have passed since boot, each call to
+ * text_lcd_post_init while text_lcd_post_ready sends one write of the same
+ * initialization, followed by clear display; it returns 1 once all are sent.
  */
 
 #include <stdint.h>
 
 // --------------------------------------------------
 
+// Pre-processor definitions
+
+// Instructions
+#define TEXT_LCD_SET_CGRAM 0x40U
+#define TEXT_LCD_SET_DDRAM 0x80U
+
+// Execution time of an instruction or data write (timer ticks, 52 us)
+#define TEXT_LCD_EXEC_TICKS 13U
+
+// Execution time of clear display (timer ticks, 1.6 ms)
+#define TEXT_LCD_CLEAR_TICKS 400U
+
+// Time from power-up before the controller takes instructions (timer ticks,
+// 40 ms)
+#define TEXT_LCD_POWER_UP_TICKS 10000UL
+
+// --------------------------------------------------
+
 void text_lcd_init();
 
 void text_lcd_clear();
@@ -30,6 +60,16 @@ void text_lcd_write_number(uint64_t);
 
 void text_lcd_place_cursor(uint16_t, uint16_t);
 
+void text_lcd_init_post();
+
+uint8_t text_lcd_post_init();
+
+uint8_t text_lcd_post_ready();
+
+void text_lcd_post_instr(uint8_t);
+
+void text_lcd_post_char(uint8_t);
+
 void text_lcd_set_backlight_rgb(uint8_t, uint8_t, uint8_t);
 
 void text_lcd_backlight_rgb_trans();
@@ -0,0 +1,64 @@
+#include "common.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "timer.h"
+
+// --------------------------------------------------
+
+// Upper 16 bits of the extended counter
+volatile uint16_t timer_overflows;
+
+// --------------------------------------------------
+
+ISR(TIMER1_OVF_vect) {
+
+  timer_overflows++;
+
+}
+
+// --------------------------------------------------
+
+void timer_init() {
+
+  timer_overflows = 0;
+
+  // Normal mode, clock / 64, overflow interrupt
+  TCCR1A = 0;
+  TCCR1B = (1 << CS11) | (1 << CS10);
+  TCNT1 = 0;
+  TIFR1 = (1 << TOV1);
+  TIMSK1 |= (1 << TOIE1);
+
+}
+
+// --------------------------------------------------
+
+uint16_t timer_read() {
+
+  // 16-bit register access shares the TEMP register with interrupts
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t ticks = TCNT1;
+  SREG = sreg;
+
+  return ticks;
+
+}
+
+// --------------------------------------------------
+
+uint32_t timer_read_long() {
+
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t high = timer_overflows;
+  uint16_t low = TCNT1;
+  // Overflow happened but its interrupt has not run yet
+  if((TIFR1 & (1 << TOV1)) && low < 0x8000U) {
+    high++;
+  }
+  SREG = sreg;
+
+  return ((uint32_t) high << 16) | low;
+
+}
@@ -0,0 +1,38 @@
+// Free-running system timer
+
+#ifndef TIMER_H
+#define TIMER_H
+
+/*
+ * Timer1, normal mode, clock / 64
+ * - One tick every 4 us (16 MHz CPU clock)
+ * - Counter wraps every 262.144 ms; differences between two reads are valid
+ *   as long as the interval being measured is shorter than that
+ * - Overflows are counted in an interrupt to extend the counter to 32 bits,
+ *   which wraps every 4.77 hours; requires global interrupts enabled
+ * - Output compare A is left free for midi_timed.c
+ */
+
+#include <stdint.h>
+
+// --------------------------------------------------
+
+// Pre-processor definitions
+
+// Duration of one timer tick (microseconds)
+#define TIMER_US_PER_TICK 4U
+
+// CPU cycles per timer tick
+#define TIMER_CYCLES_PER_TICK 64U
+
+// --------------------------------------------------
+
+void timer_init();
+
+uint16_t timer_read();
+
+uint32_t timer_read_long();
+
+// --------------------------------------------------
+
+#endif
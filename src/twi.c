@@ -1,14 +1,38 @@
 #include "common.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 #include "twi.h"
 
 #define TWI_STOP_PERIOD 10U
 
+// Status codes
+#define TWI_START 0x08U
+#define TWI_RESTART 0x10U
+#define TWI_SLAW_ACK 0x18U
+#define TWI_DATA_ACK 0x28U
+#define TWI_SLAR_ACK 0x40U
+#define TWI_RECV_ACK 0x50U
+#define TWI_RECV_NACK 0x58U
+
+// --------------------------------------------------
+
+// Interrupt-driven register read in flight
+volatile uint8_t twi_read_addr;
+volatile uint8_t twi_read_reg;
+volatile uint8_t *twi_read_buf;
+volatile uint8_t twi_read_len;
+volatile uint8_t twi_read_pos;
+volatile uint8_t twi_read_busy;
+volatile uint8_t twi_read_failed;
+
 // --------------------------------------------------
 
 uint8_t twi_transmit_start() {
 
+  // Let a stop condition issued by the interrupt complete
+  while(TWCR & (1 << TWSTO));
+
   TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
   while(!(TWCR & (1 << TWINT)));
   if(TWSR != 0x08) {
@@ -119,3 +143,99 @@ uint8_t twi_receive_data_nack(uint8_t *data) {
   return 0;
 
 }
+
+// --------------------------------------------------
+
+// Read a number of registers (at least 1) starting at a register address
+void twi_read_start(uint8_t slave_addr, uint8_t reg, volatile uint8_t *buf,
+uint8_t len) {
+
+  while(TWCR & (1 << TWSTO));
+
+  twi_read_addr = slave_addr << 1;
+  twi_read_reg = reg;
+  twi_read_buf = buf;
+  twi_read_len = len;
+  twi_read_pos = 0;
+  twi_read_failed = 0;
+  twi_read_busy = 1;
+
+  TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+
+}
+
+// --------------------------------------------------
+
+uint8_t twi_read_done() {
+
+  return !twi_read_busy;
+
+}
+
+// --------------------------------------------------
+
+uint8_t twi_read_error() {
+
+  return twi_read_failed;
+
+}
+
+// --------------------------------------------------
+
+ISR(TWI_vect) {
+
+  switch(TWSR & 0xf8U) {
+
+    // Transmit slave address + write
+    case TWI_START:
+      TWDR = twi_read_addr;
+      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      return;
+
+    // Transmit register address
+    case TWI_SLAW_ACK:
+      TWDR = twi_read_reg;
+      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      return;
+
+    // Transmit restart condition
+    case TWI_DATA_ACK:
+      TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+      return;
+
+    // Transmit slave address + read
+    case TWI_RESTART:
+      TWDR = twi_read_addr | 0x01;
+      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      return;
+
+    // Store data byte, then receive next with ACK, or the last with NACK
+    case TWI_RECV_ACK:
+      twi_read_buf[twi_read_pos] = TWDR;
+      twi_read_pos++;
+      // Fall through
+    case TWI_SLAR_ACK:
+      if(twi_read_pos + 1 < twi_read_len) {
+        TWCR = (1 << TWINT) | (1 << TWEA) | (1 << TWEN) | (1 << TWIE);
+      } else {
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      }
+      return;
+
+    // Store last data byte
+    case TWI_RECV_NACK:
+      twi_read_buf[twi_read_pos] = TWDR;
+      break;
+
+    // Not acknowledged, arbitration lost or bus error
+    default:
+      twi_read_failed = 1;
+      break;
+
+  }
+
+  // Transmit stop condition; completes without a further interrupt
+  TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+  twi_read_busy = 0;
+
+}
@@ -3,6 +3,12 @@
 #ifndef TWI_H
 #define TWI_H
 
+/*
+ * Blocking transfers poll TWINT. A register read can instead run from the
+ * TWI interrupt (twi_read_start), leaving the CPU free until twi_read_done;
+ * blocking transfers must not be started while it is in flight.
+ */
+
 #include <stdint.h>
 
 // --------------------------------------------------
@@ -21,6 +27,12 @@ uint8_t twi_receive_data_ack(uint8_t *);
 
 uint8_t twi_receive_data_nack(uint8_t *);
 
+void twi_read_start(uint8_t, uint8_t, volatile uint8_t *, uint8_t);
+
+uint8_t twi_read_done();
+
+uint8_t twi_read_error();
+
 // --------------------------------------------------
 
 #endif